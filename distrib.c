@@ -0,0 +1,451 @@
+/* ****************************************************************************************************************** *
+ * Name:	distrib.c
+ * Description:	A simple coordinator/worker job distributor. Jobs and results are single lines of text, so it knows
+ * 		nothing about the problem being solved. The problem domain supplies one function:
+ * 			handle(JOB)
+ * 				Solves a job, returning a malloc'd result line (without a newline) or NULL on failure.
+ *
+ * 		A worker reads lines of the form "<id> <job>" from its input and writes "<id> <result>" to its
+ * 		output for each one, until its input is closed. A job which can't be solved gets the result "ERR"
+ * 		(DISTRIB_ERROR) and the worker carries on with the next one. Workers are either local processes forked by the
+ * 		coordinator and connected by pipes (spec "local"), or remote processes started with distrib_serve()
+ * 		and reached over TCP (spec "host:port").
+ *
+ * 		The coordinator, distrib_run(), gives each worker one job at a time. If a worker dies (its pipe or
+ * 		socket closes) or doesn't reply within its job's time limit and DISTRIB_SLACK (eg. its host lost power or
+ * 		its network), its job is given to another worker, up to DISTRIB_ATTEMPTS times. A job whose result is
+ * 		DISTRIB_ERROR fails without being retried, as it would fail on every worker.
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#include "distrib.h"
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define PRIVATE		static
+#define PUBLIC
+#define NO_JOB		-1
+
+/* ******** *
+ * Typedefs *
+ * ******** */
+typedef struct Worker {						/* Coordinator's view of a worker		      */
+	int in;							/* Results are read from here			      */
+	int out;						/* Jobs are written to here			      */
+	pid_t pid;						/* Process id of a local worker, else 0		      */
+	bool alive;
+	int job;						/* Index of job being run, or NO_JOB		      */
+	double deadline;					/* Time job is given up by, or 0 for never	      */
+	char buf[DISTRIB_LINE];					/* Partially read result line			      */
+	int len;
+} Worker;
+
+typedef enum { PENDING, RUNNING, FINISHED, FAILED } JobStatus;
+
+/* ********** *
+ * Prototypes *
+ * ********** */
+PUBLIC bool distrib_run    (char **specs, int n_specs, char **jobs, int *limits, char **results, int n_jobs,
+			    char *(*handle)(const char *job));
+PUBLIC int  distrib_worker (int in, int out, char *(*handle)(const char *job));
+PUBLIC int  distrib_serve  (const char *port, char *(*handle)(const char *job));
+
+PRIVATE bool worker_local   (Worker *workers, int n, char *(*handle)(const char *job));
+PRIVATE bool worker_remote  (Worker *worker, const char *spec);
+PRIVATE void worker_kill    (Worker *worker, JobStatus *status);
+PRIVATE bool worker_read    (Worker *worker, char **results, JobStatus *status);
+PRIVATE bool write_all      (int fd, const char *buf, size_t len);
+PRIVATE double now          (void);
+
+/* ********* *
+ * Functions *
+ * ********* */
+/*
+ * Runs every job on the workers given by specs, storing each job's malloc'd result in results (NULL if the job
+ * failed on every attempt). limits, if not NULL, gives the seconds each job should take (0 for no limit), and a
+ * worker which hasn't replied DISTRIB_SLACK seconds after that is given up as dead. Returns true if every job
+ * finished.
+ */
+PUBLIC bool distrib_run(char **specs, int n_specs, char **jobs, int *limits, char **results, int n_jobs,
+			char *(*handle)(const char *job)) {
+	Worker *workers;
+	JobStatus *status;
+	int *attempts;
+	int i, j, n_workers = 0, alive, left = n_jobs, max_fd, len, ready;
+	char line[DISTRIB_LINE];
+	fd_set fds;
+	struct timeval timeout;
+	double next;
+	bool success = true;
+
+	signal(SIGPIPE, SIG_IGN);					/* Dead workers are found by write errors     */
+
+	workers = (Worker *)calloc(n_specs, sizeof(Worker));
+	status = (JobStatus *)calloc(n_jobs, sizeof(JobStatus));
+	attempts = (int *)calloc(n_jobs, sizeof(int));
+	for (i = 0; i < n_jobs; i++) results[i] = NULL;
+
+	/* Start workers */
+	for (i = 0; i < n_specs; i++) {
+		if (strcmp(specs[i], DISTRIB_LOCAL) == 0) {
+			if (!worker_local(workers, n_workers, handle)) continue;
+		} else {
+			if (!worker_remote(&workers[n_workers], specs[i])) {
+				fprintf(stderr, "Error: could not connect to worker %s\n", specs[i]);
+				continue;
+			}
+		}
+		n_workers++;
+	}
+
+	while (left > 0) {
+		/* Give a pending job to every idle worker */
+		for (i = 0, j = 0; i < n_workers; i++) {
+			if (!workers[i].alive || workers[i].job != NO_JOB) continue;
+			while (j < n_jobs && status[j] != PENDING) j++;
+			if (j == n_jobs) break;
+
+			len = snprintf(line, sizeof(line), "%d %s\n", j, jobs[j]);
+			status[j] = RUNNING;
+			attempts[j]++;
+			workers[i].job = j;
+			workers[i].deadline = (limits && limits[j] > 0) ? now() + limits[j] + DISTRIB_SLACK : 0;
+			if (len >= (int)sizeof(line) || !write_all(workers[i].out, line, len)) {
+				worker_kill(&workers[i], status);
+			}
+		}
+
+		/* Wait for results from busy workers, until the nearest deadline */
+		FD_ZERO(&fds);
+		max_fd = -1;
+		next = 0;
+		for (i = 0, alive = 0; i < n_workers; i++) {
+			if (!workers[i].alive) continue;
+			alive++;
+			if (workers[i].job == NO_JOB) continue;
+			FD_SET(workers[i].in, &fds);
+			if (workers[i].in > max_fd) max_fd = workers[i].in;
+			if (workers[i].deadline > 0 && (next == 0 || workers[i].deadline < next)) next = workers[i].deadline;
+		}
+
+		/* Give up on jobs which have run out of attempts or workers */
+		for (j = 0; j < n_jobs; j++) {
+			if (status[j] != PENDING) continue;
+			if (attempts[j] >= DISTRIB_ATTEMPTS || alive == 0) {
+				status[j] = FAILED;
+				left--;
+			}
+		}
+		if (max_fd < 0) continue;
+
+		if (next > 0) {
+			next = (next > now()) ? next - now() : 0;
+			timeout.tv_sec = (long)next;
+			timeout.tv_usec = (long)((next - timeout.tv_sec) * 1e6);
+		}
+		if ((ready = select(max_fd + 1, &fds, NULL, NULL, (next > 0) ? &timeout : NULL)) < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+
+		for (i = 0; ready > 0 && i < n_workers; i++) {
+			if (!workers[i].alive || !FD_ISSET(workers[i].in, &fds)) continue;
+			if (worker_read(&workers[i], results, status)) left--;
+		}
+
+		/* A worker which is silent past its deadline is taken to be dead, so its job is retried elsewhere */
+		for (i = 0; i < n_workers; i++) {
+			if (!workers[i].alive || workers[i].job == NO_JOB || workers[i].deadline == 0) continue;
+			if (now() < workers[i].deadline) continue;
+			fprintf(stderr, "Error: worker %d timed out on job %d\n", i, workers[i].job);
+			if (workers[i].pid > 0) kill(workers[i].pid, SIGKILL);
+			worker_kill(&workers[i], status);
+		}
+	}
+
+	/* Closing a worker's input makes it exit */
+	for (i = 0; i < n_workers; i++) {
+		if (workers[i].alive) worker_kill(&workers[i], status);
+		if (workers[i].pid > 0) waitpid(workers[i].pid, NULL, 0);
+	}
+
+	for (j = 0; j < n_jobs; j++) if (status[j] != FINISHED) success = false;
+
+	free(workers);
+	free(status);
+	free(attempts);
+
+	return success;
+}
+
+/*
+ * Serves jobs read from in, writing results to out, until in or out is closed. Returns 0.
+ */
+PUBLIC int distrib_worker(int in, int out, char *(*handle)(const char *job)) {
+	FILE *input;
+	char line[DISTRIB_LINE], reply[DISTRIB_LINE], *job, *result;
+	int id, len;
+
+	if ((input = fdopen(in, "r")) == NULL) return 1;
+
+	while (fgets(line, sizeof(line), input) != NULL) {
+		line[strcspn(line, "\n")] = '\0';
+
+		/* Split "<id> <job>" */
+		id = (int)strtol(line, &job, 10);
+		if (job == line || *job != ' ') continue;
+		job++;
+
+		/* A failed job is reported, not fatal, so one bad job doesn't kill every worker in turn */
+		result = handle(job);
+		len = snprintf(reply, sizeof(reply), "%d %s\n", id, (result != NULL) ? result : DISTRIB_ERROR);
+		free(result);
+		if (len >= (int)sizeof(reply)) len = snprintf(reply, sizeof(reply), "%d %s\n", id, DISTRIB_ERROR);
+		if (!write_all(out, reply, len)) break;
+	}
+
+	fclose(input);
+	return 0;
+}
+
+/*
+ * Listens on a TCP port, serving each connection with distrib_worker() in its own process. Only returns on error.
+ */
+PUBLIC int distrib_serve(const char *port, char *(*handle)(const char *job)) {
+	struct addrinfo hints, *addrs, *addr;
+	int sock = -1, conn, on = 1;
+	pid_t pid;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	if (getaddrinfo(NULL, port, &hints, &addrs) != 0) return 1;
+
+	/* Bind to first usable address */
+	for (addr = addrs; addr != NULL; addr = addr->ai_next) {
+		sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+		if (sock < 0) continue;
+		setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		if (bind(sock, addr->ai_addr, addr->ai_addrlen) == 0 && listen(sock, SOMAXCONN) == 0) break;
+		close(sock);
+		sock = -1;
+	}
+	freeaddrinfo(addrs);
+	if (sock < 0) return 1;
+
+	signal(SIGCHLD, SIG_IGN);					/* Finished workers are reaped by the kernel  */
+	signal(SIGPIPE, SIG_IGN);
+
+	for (;;) {
+		conn = accept(sock, NULL, NULL);
+		if (conn < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+
+		pid = fork();
+		if (pid == 0) {						/* Child serves this connection		      */
+			close(sock);
+			signal(SIGINT, SIG_DFL);			/* Only server handles signals		      */
+			signal(SIGTERM, SIG_DFL);
+			distrib_worker(dup(conn), conn, handle);
+			_exit(0);
+		}
+		close(conn);
+	}
+
+	close(sock);
+	return 1;
+}
+
+/*
+ * Forks a local worker process connected by pipes, storing it as workers[n]. The other workers' pipes are closed in
+ * the child so that it does not keep them open.
+ */
+PRIVATE bool worker_local(Worker *workers, int n, char *(*handle)(const char *job)) {
+	int jobs_pipe[2], results_pipe[2], i;
+	pid_t pid;
+
+	if (pipe(jobs_pipe) != 0) return false;
+	if (pipe(results_pipe) != 0) {
+		close(jobs_pipe[0]);
+		close(jobs_pipe[1]);
+		return false;
+	}
+
+	fflush(stdout);							/* Don't duplicate buffered output	      */
+	pid = fork();
+	if (pid < 0) {
+		close(jobs_pipe[0]);
+		close(jobs_pipe[1]);
+		close(results_pipe[0]);
+		close(results_pipe[1]);
+		return false;
+	}
+
+	if (pid == 0) {							/* Child runs jobs until pipe closes	      */
+		signal(SIGINT, SIG_DFL);				/* Only coordinator handles signals	      */
+		signal(SIGTERM, SIG_DFL);
+		for (i = 0; i < n; i++) {
+			if (!workers[i].alive) continue;
+			close(workers[i].in);
+			close(workers[i].out);
+		}
+		close(jobs_pipe[1]);
+		close(results_pipe[0]);
+		_exit(distrib_worker(jobs_pipe[0], results_pipe[1], handle));
+	}
+
+	close(jobs_pipe[0]);
+	close(results_pipe[1]);
+	workers[n].in = results_pipe[0];
+	workers[n].out = jobs_pipe[1];
+	workers[n].pid = pid;
+	workers[n].alive = true;
+	workers[n].job = NO_JOB;
+	workers[n].len = 0;
+
+	return true;
+}
+
+/*
+ * Connects to a remote worker given by a "host:port" spec.
+ */
+PRIVATE bool worker_remote(Worker *worker, const char *spec) {
+	struct addrinfo hints, *addrs, *addr;
+	char host[DISTRIB_LINE], *port;
+	int sock = -1, on = 1;
+
+	/* Split spec at last ':' so that the port is found after IPv6 addresses too */
+	if (strlen(spec) >= sizeof(host)) return false;
+	strcpy(host, spec);
+	if ((port = strrchr(host, ':')) == NULL) return false;
+	*port++ = '\0';
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, port, &hints, &addrs) != 0) return false;
+
+	for (addr = addrs; addr != NULL; addr = addr->ai_next) {
+		sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+		if (sock < 0) continue;
+		if (connect(sock, addr->ai_addr, addr->ai_addrlen) == 0) break;
+		close(sock);
+		sock = -1;
+	}
+	freeaddrinfo(addrs);
+	if (sock < 0) return false;
+
+	/* Have the kernel probe an idle connection, so a host which vanishes is noticed */
+	setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+
+	worker->in = sock;
+	worker->out = dup(sock);
+	worker->pid = 0;
+	worker->alive = true;
+	worker->job = NO_JOB;
+	worker->len = 0;
+
+	return true;
+}
+
+/*
+ * Closes a worker's connection, returning its unfinished job to the pending jobs.
+ */
+PRIVATE void worker_kill(Worker *worker, JobStatus *status) {
+	if (worker->job != NO_JOB) status[worker->job] = PENDING;
+	worker->job = NO_JOB;
+	worker->alive = false;
+	close(worker->in);
+	close(worker->out);
+}
+
+/*
+ * Reads available output from a worker. Returns true if this finished or failed its job.
+ */
+PRIVATE bool worker_read(Worker *worker, char **results, JobStatus *status) {
+	ssize_t n;
+	char *end, *result;
+	int id;
+
+	n = read(worker->in, worker->buf + worker->len, sizeof(worker->buf) - worker->len - 1);
+	if (n <= 0) {							/* Worker died				      */
+		worker_kill(worker, status);
+		return false;
+	}
+	worker->len += n;
+	worker->buf[worker->len] = '\0';
+
+	/* Wait for a complete line */
+	if ((end = strchr(worker->buf, '\n')) == NULL) {
+		if (worker->len == sizeof(worker->buf) - 1) worker_kill(worker, status);
+		return false;
+	}
+	*end = '\0';
+
+	/* Split "<id> <result>", ignoring replies to jobs this worker no longer has */
+	id = (int)strtol(worker->buf, &result, 10);
+	worker->len = 0;
+	if (result == worker->buf || *result != ' ' || id != worker->job) {
+		worker_kill(worker, status);
+		return false;
+	}
+
+	worker->job = NO_JOB;
+	if (strcmp(result + 1, DISTRIB_ERROR) == 0) {			/* Would fail anywhere, so don't retry	      */
+		status[id] = FAILED;
+	} else {
+		results[id] = strdup(result + 1);
+		status[id] = FINISHED;
+	}
+
+	return true;
+}
+
+/*
+ * Writes all of buf to fd. Returns false on error.
+ */
+PRIVATE bool write_all(int fd, const char *buf, size_t len) {
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		buf += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+/*
+ * Returns the seconds on a clock which only moves forward.
+ */
+PRIVATE double now(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
@@ -0,0 +1,34 @@
+/* ****************************************************************************************************************** *
+ * Name:	distrib.h
+ * Description:	Header file for distrib.c
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+#ifndef _DISTRIB_H
+#define _DISTRIB_H
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include <stdbool.h>
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define DISTRIB_LINE		1024					/* Max length of a job or result line	      */
+#define DISTRIB_ATTEMPTS	3					/* Times a job is tried before giving up      */
+#define DISTRIB_LOCAL		"local"					/* Worker spec for a local worker process     */
+#define DISTRIB_ERROR		"ERR"					/* Result of a job which can't be solved      */
+#define DISTRIB_SLACK		5					/* Seconds a job may overrun its time limit   */
+
+/* ********** *
+ * Prototypes *
+ * ********** */
+extern bool distrib_run    (char **specs, int n_specs,			/* Runs jobs on workers, collecting results   */
+			    char **jobs, int *limits, char **results, int n_jobs,
+			    char *(*handle)(const char *job));
+extern int  distrib_worker (int in, int out, char *(*handle)(const char *job));	/* Serves jobs on a pipe/socket */
+extern int  distrib_serve  (const char *port, char *(*handle)(const char *job));	/* Serves jobs on a TCP port */
+
+#endif
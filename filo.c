@@ -12,6 +12,7 @@
 #include <stdbool.h>
 
 #include "filo.h"
+#include "profile.h"
 
 /* ********* *
  * Functions *
@@ -19,7 +20,9 @@
 void filo_push(Filo **filo, void *value) {
 	Filo *node;
 	if (!filo) return;				/* Check for null pointer				      */
+	PROFILE_ENTER(PROF_ALLOC);
 	node = (Filo *)calloc(1, sizeof(Filo));		/* Create node						      */
+	PROFILE_LEAVE();
 	node->value = value;
 	node->next = *filo;
 	*filo = node;					/* Update head						      */
@@ -33,7 +36,9 @@ void *filo_pop(Filo **filo) {
 	head = *filo;
 	value = head->value;
 	*filo = head->next;				/* Update head						      */
+	PROFILE_ENTER(PROF_ALLOC);
 	free(head);					/* Remove old head					      */
+	PROFILE_LEAVE();
 	return value;					/* Return value of removed node				      */
 }
 
@@ -0,0 +1,279 @@
+/* ****************************************************************************************************************** *
+ * Name:	gamehost.c
+ * Description:	Hosts many games in one process. Games waiting for a move are queued and a fixed pool of threads 
+ * 		takes them in turn, running compute_game_move() for each. Each thread's search is independent, while 
+ * 		all of them share othelloAI's transposition table. When a game has been given a move it is passed to 
+ * 		the moved() callback, from the thread which searched it.
+ * 
+ * 		Engine state kept between a game's moves (eg. its MCTS tree) is in a Context looked up by the game's 
+ * 		id, so it follows the game to whichever thread searches its next move. Up to MAX_CONTEXTS are kept, 
+ * 		the least recently used being dropped to make room, and a game's context is dropped when it has no 
+ * 		move left.
+ * 
+ * 		The time for each move is the smaller of the game's fair share of its own clock and its share of the 
+ * 		host's CPU budget. The budget is the number of CPU seconds to be spent on all games waiting or being 
+ * 		searched at once. Time already given to running searches is taken out of it, and the rest is divided 
+ * 		among the waiting games in proportion to their clocks, so that a busy host plays faster rather than 
+ * 		letting games' clocks run out in the queue. No search gets more than one thread's share of the 
+ * 		budget, so a game taken from an otherwise empty queue leaves time for games which arrive while it is 
+ * 		searched. Only MIN_TIME, given when the budget is used up, can take the total over budget. Times are 
+ * 		allotted in milliseconds, which the searches keep to, so even short moves get their share.
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "gamehost.h"
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define PRIVATE		static
+#define PUBLIC
+#define MIN_TIME	10						/* Least milliseconds given to any search     */
+#define MAX_CONTEXTS	4096						/* Most games whose contexts are kept	      */
+#define BUCKETS		1024						/* Hash buckets of contexts, a power of 2     */
+
+/* ******** *
+ * Typedefs *
+ * ******** */
+typedef struct GameContext {					/* A game's engine state, found by its id	      */
+	char id[GAME_ID_MAX];
+	Context context;
+	bool busy;						/* A search is using context			      */
+	long used;						/* Value of host_moves when last used		      */
+	struct GameContext *next;				/* Next context in hash bucket			      */
+} GameContext;
+
+/* ********** *
+ * Prototypes *
+ * ********** */
+PUBLIC bool gamehost_start  (int threads, int budget, void (*moved)(Game *game));
+PUBLIC void gamehost_submit (Game *game);
+PUBLIC void gamehost_stop   (void);
+
+PRIVATE void *host_thread   (void *arg);
+PRIVATE int   allot_time    (Game *game);
+PRIVATE GameContext *context_find (const char *id);
+PRIVATE void  context_drop  (GameContext *ctx);
+PRIVATE unsigned int id_hash (const char *id);
+
+/* ******* *
+ * Globals *
+ * ******* */
+PRIVATE pthread_t      *host_threads = NULL;				/* Thread pool			      */
+PRIVATE int             host_n_threads = 0;
+PRIVATE long            host_budget;					/* CPU ms for all waiting games	      */
+PRIVATE long            host_share;					/* Most of budget one search may have */
+PRIVATE void          (*host_moved)(Game *game);			/* Called with each finished game     */
+PRIVATE Game           *queue_head = NULL;				/* Games waiting for a move	      */
+PRIVATE Game           *queue_tail = NULL;
+PRIVATE long            queue_clocks = 0;				/* Sum of clocks of waiting games     */
+PRIVATE long            running_time = 0;				/* Sum of times of running searches   */
+PRIVATE GameContext    *contexts[BUCKETS];				/* Contexts of games, by id_hash()    */
+PRIVATE int             n_contexts = 0;
+PRIVATE long            host_moves = 0;					/* Searches started, to order contexts */
+PRIVATE bool            host_stopping = false;
+PRIVATE pthread_mutex_t host_mutex = PTHREAD_MUTEX_INITIALIZER;		/* Guards queue, contexts and stop    */
+PRIVATE pthread_cond_t  host_cond = PTHREAD_COND_INITIALIZER;		/* Signals a queued game or stop      */
+
+/* ********* *
+ * Functions *
+ * ********* */
+/*
+ * Starts a pool of threads to play games, sharing budget CPU seconds. moved() is called with each game once it has its 
+ * move.
+ */
+PUBLIC bool gamehost_start(int threads, int budget, void (*moved)(Game *game)) {
+	if (threads <= 0 || budget <= 0 || !moved || host_threads != NULL) return false;
+	
+	host_budget = budget * 1000L;
+	host_share = (host_budget / threads > MIN_TIME) ? host_budget / threads : MIN_TIME;
+	host_moved = moved;
+	host_stopping = false;
+	host_threads = (pthread_t *)calloc(threads, sizeof(pthread_t));
+	for (host_n_threads = 0; host_n_threads < threads; host_n_threads++) {
+		if (pthread_create(&host_threads[host_n_threads], NULL, host_thread, NULL) != 0) break;
+	}
+	
+	/* Need at least one thread to play */
+	if (host_n_threads == 0) {
+		free(host_threads);
+		host_threads = NULL;
+		return false;
+	}
+	
+	return true;
+}
+
+/*
+ * Queues a game to be given its next move.
+ */
+PUBLIC void gamehost_submit(Game *game) {
+	game->next = NULL;
+	game->move = NULL;
+	
+	pthread_mutex_lock(&host_mutex);
+	if (queue_tail != NULL) queue_tail->next = game;
+	else queue_head = game;
+	queue_tail = game;
+	queue_clocks += game->clock;
+	pthread_cond_signal(&host_cond);
+	pthread_mutex_unlock(&host_mutex);
+}
+
+/*
+ * Waits for every queued game to be given its move, then stops the thread pool.
+ */
+PUBLIC void gamehost_stop(void) {
+	int i;
+	
+	pthread_mutex_lock(&host_mutex);
+	host_stopping = true;
+	pthread_cond_broadcast(&host_cond);
+	pthread_mutex_unlock(&host_mutex);
+	
+	for (i = 0; i < host_n_threads; i++) pthread_join(host_threads[i], NULL);
+	free(host_threads);
+	host_threads = NULL;
+	host_n_threads = 0;
+	
+	for (i = 0; i < BUCKETS; i++) while (contexts[i] != NULL) context_drop(contexts[i]);
+}
+
+/*
+ * Plays queued games until the host is stopped and the queue is empty.
+ */
+PRIVATE void *host_thread(void *arg) {
+	GameContext *ctx;
+	Game *game;
+	bool own;
+	
+	for (;;) {
+		/* Take the next game */
+		pthread_mutex_lock(&host_mutex);
+		while (queue_head == NULL && !host_stopping) pthread_cond_wait(&host_cond, &host_mutex);
+		if (queue_head == NULL) {
+			pthread_mutex_unlock(&host_mutex);
+			break;
+		}
+		game = queue_head;
+		queue_head = game->next;
+		if (queue_head == NULL) queue_tail = NULL;
+		game->time = allot_time(game);
+		queue_clocks -= game->clock;
+		running_time += game->time;
+		
+		/* A game queued twice at once searches its second copy without its context */
+		ctx = context_find(game->id);
+		own = (ctx != NULL && !ctx->busy);
+		if (own) {
+			ctx->busy = true;
+			ctx->used = host_moves++;
+		}
+		pthread_mutex_unlock(&host_mutex);
+		
+		game->move = compute_game_move(&(game->state), game->time, (own) ? &(ctx->context) : NULL);
+		game->depth = compute_move_depth();
+		game->nodes = compute_move_nodes();
+		
+		/* Return time to budget and context to game before game may be resubmitted */
+		pthread_mutex_lock(&host_mutex);
+		running_time -= game->time;
+		if (own) {
+			ctx->busy = false;
+			if (game->move == NULL) context_drop(ctx);	/* Game is over			      */
+		}
+		pthread_mutex_unlock(&host_mutex);
+		host_moved(game);
+	}
+	
+	return NULL;
+}
+
+/*
+ * Finds the time to give a game's search. Called with host_mutex held while the game is still counted in queue_clocks 
+ * and not yet in running_time.
+ */
+PRIVATE int allot_time(Game *game) {
+	int i, empty = 0, by_clock, by_budget, time;
+	long left;
+	
+	for (i = 0; i < BOARD_SIZE; i++) if (game->state.board[i] == EMPTY) empty++;
+	
+	by_clock = game->clock * 1000L / (empty / 2 + 1);		/* Our moves left is about half the empties   */
+	left = host_budget - running_time;				/* Budget not held by running searches	      */
+	if (left < 0) left = 0;
+	by_budget = (queue_clocks > 0) ? (int)(left * game->clock / queue_clocks) : (int)left;
+	if (by_budget > host_share) by_budget = host_share;
+	
+	time = (by_clock < by_budget) ? by_clock : by_budget;
+	
+	return (time < MIN_TIME) ? MIN_TIME : time;
+}
+
+/*
+ * Finds the context of the game with this id, creating it if needed. If there are MAX_CONTEXTS already, the least 
+ * recently used one not being searched is dropped first. Called with host_mutex held. Returns NULL if memory runs out.
+ */
+PRIVATE GameContext *context_find(const char *id) {
+	GameContext *ctx, *oldest = NULL;
+	unsigned int bucket = id_hash(id);
+	int i;
+	
+	for (ctx = contexts[bucket]; ctx != NULL; ctx = ctx->next) {
+		if (strcmp(ctx->id, id) == 0) return ctx;
+	}
+	
+	/* Make room */
+	if (n_contexts >= MAX_CONTEXTS) {
+		for (i = 0; i < BUCKETS; i++) {
+			for (ctx = contexts[i]; ctx != NULL; ctx = ctx->next) {
+				if (!ctx->busy && (oldest == NULL || ctx->used < oldest->used)) oldest = ctx;
+			}
+		}
+		if (oldest == NULL) return NULL;
+		context_drop(oldest);
+	}
+	
+	if ((ctx = (GameContext *)calloc(1, sizeof(GameContext))) == NULL) return NULL;
+	strncpy(ctx->id, id, GAME_ID_MAX - 1);
+	ctx->next = contexts[bucket];
+	contexts[bucket] = ctx;
+	n_contexts++;
+	
+	return ctx;
+}
+
+/*
+ * Removes a context which is not being searched and frees it, with the engine state kept in it. Called with host_mutex 
+ * held.
+ */
+PRIVATE void context_drop(GameContext *ctx) {
+	GameContext **link = &contexts[id_hash(ctx->id)];
+	
+	while (*link != ctx) link = &((*link)->next);
+	*link = ctx->next;
+	n_contexts--;
+	
+	context_clear(&(ctx->context));
+	free(ctx);
+}
+
+/*
+ * Hashes a game id to a bucket of contexts (FNV-1a).
+ */
+PRIVATE unsigned int id_hash(const char *id) {
+	unsigned int h = 2166136261u;
+	
+	for (; *id != '\0'; id++) h = (h ^ (unsigned char)*id) * 16777619u;
+	
+	return h & (BUCKETS - 1);
+}
@@ -0,0 +1,44 @@
+/* ****************************************************************************************************************** *
+ * Name:	gamehost.h
+ * Description:	Header file for gamehost.c
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+#ifndef _GAMEHOST_H
+#define _GAMEHOST_H
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include <stdbool.h>
+
+#include "othelloAI.h"
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define GAME_ID_MAX	64						/* Max length of a game's id		      */
+
+/* ******** *
+ * Typedefs *
+ * ******** */
+typedef struct Game {						/* A game waiting for, or given, its next move	      */
+	char id[GAME_ID_MAX];
+	State state;
+	int clock;						/* Seconds left on this player's clock		      */
+	int time;						/* Milliseconds given to the search for this move     */
+	Action *move;						/* Move found, or NULL if no move possible	      */
+	int depth;
+	int nodes;
+	struct Game *next;					/* Next game in queue				      */
+} Game;
+
+/* ********** *
+ * Prototypes *
+ * ********** */
+extern bool gamehost_start  (int threads, int budget, void (*moved)(Game *game));	/* Starts thread pool	      */
+extern void gamehost_submit (Game *game);			/* Queues a game to be given its next move	      */
+extern void gamehost_stop   (void);				/* Finishes queued games and stops thread pool	      */
+
+#endif
@@ -0,0 +1,711 @@
+/* ****************************************************************************************************************** *
+ * Name:	mcts.c
+ * Description:	A generic Monte Carlo tree search (UCT) which finds the next best move for a game when provided with
+ * 		the required problem domain specific functions. It plays better than minmaxsearch when there is only
+ * 		time to search a few plies. These functions are:
+ * 			actions(STATE)
+ * 				Returns a Filo<ACTION> containing the actions which are possible to perform on this
+ * 				state.
+ * 			result(ACTION, STATE)
+ * 				Applies the action to the state, returning the resulting state.
+ * 			terminal_test(STATE)
+ * 				Returns true if this state is a terminal state, false otherwise.
+ * 			successors(STATE)
+ * 				Returns a Filo<STATE> containing the the children of this state.
+ * 			playout_step(STATE, seed)
+ * 				Returns a new random (or lightly guided) child of this state, chosen using rand_r(seed),
+ * 				or NULL if this state is a terminal state. Must be fast, as playouts are made of these.
+ * 			outcome(STATE, ROOT)
+ * 				Returns > 0 if the player to move in ROOT has won the terminal STATE, < 0 if they have
+ * 				lost and 0 for a draw. The size is the margin of the result (eg. a disc difference).
+ * 			equal(STATE, STATE)
+ * 				Returns true if the states are the same.
+ *
+ * 		And some non-algorithm utility functions:
+ * 			copy(STATE)
+ * 				Returns a copy of a state.
+ * 			set_estimate(ACTION, estimate)
+ * 				Updates the estimate value associated with this action.
+ * 			free_action(ACTION)
+ * 				Safely frees an action.
+ * 			free_state(STATE)
+ * 				Safely frees a state.
+ *
+ * 		A search is started by calling mcts_decision() with the initial state of this search.
+ * 		Important! mcts_init() must be run before mcts_decision() with valid arguments.
+ *
+ * 		The search runs playouts until the time limit, then returns the most visited action. Moves are chosen
+ * 		by points won (a win is 2 points, a draw 1), but the action's estimate is set to the mean outcome of
+ * 		its playouts, so it is on the scale of outcome() rather than a win rate. Tree nodes come from a pool
+ * 		allocated once per thread. When the pool is full the tree stops growing but playouts go on.
+ *
+ * 		The tree is searched by several threads at once (tree parallelisation). A thread adds a virtual
+ * 		loss to every node it passes through, so that other threads prefer other paths until its playout is
+ * 		backed up.
+ *
+ * 		Each thread keeps its tree between searches. If the thread's next search's initial state is in the top
+ * 		two plies of its last tree (eg. after our move and the opponent's reply) that subtree becomes the new
+ * 		tree. A caller which searches many games, each on whichever thread is free, instead gives each search
+ * 		its game's MctsTree with mcts_set_tree(). The search starts from the game's kept tree, then keeps the
+ * 		subtree of the chosen move (up to KEEP_NODES nodes, nearest the root first) for the game's next
+ * 		search, so the tree follows the game rather than the thread.
+ *
+ * 		Search state is thread local, so searches may run on several threads at once. Each thread must call
+ * 		mcts_init() itself. Times are in milliseconds.
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mcts.h"
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define PRIVATE		static
+#define PUBLIC
+#define POOL_SIZE	(1 << 17)					/* Nodes in each of a tree's two pools	      */
+#define MAX_PATH	256						/* Longer than any game			      */
+#define MAX_THREADS	64
+#define EXPLORATION	1.0						/* UCT exploration constant		      */
+#define VIRTUAL_LOSS	3						/* Visits added by a thread passing a node    */
+#define EXPAND_VISITS	2						/* Visits before a leaf is expanded	      */
+#define KEEP_NODES	1024						/* Most nodes kept for a game's next search   */
+
+/* Status of a node */
+#define LEAF		0
+#define EXPANDING	1
+#define EXPANDED	2
+#define TERMINAL	3
+
+/* ******** *
+ * Typedefs *
+ * ******** */
+typedef struct Node {						/* A node of the search tree			      */
+	STATE *state;
+	ACTION *action;						/* Action leading to a child of the root	      */
+	int first_child;					/* Index of first child, children are contiguous     */
+	int n_children;
+	bool root_moved;					/* Player to move at root moved into this node	      */
+	atomic_int status;
+	atomic_int visits;
+	atomic_int points;					/* Won by player who moved into this node	      */
+	atomic_long margin;					/* Sum of outcomes for player who moved here	      */
+} Node;
+
+typedef struct Pool {						/* Pool allocator of nodes			      */
+	Node *nodes;
+	atomic_int used;
+} Pool;
+
+typedef struct Tree {						/* A thread's search tree and search state	      */
+	Pool pools[2];						/* Nodes are in pools[current], root at 0	      */
+	int current;
+	STATE *root_state;					/* Initial state of the last search		      */
+	Filo *actions;						/* Actions of the root				      */
+	struct timespec deadline;
+	atomic_bool *stop_flag;
+	MctsTree **kept;					/* Game's kept tree, or NULL to keep this one	      */
+	atomic_int playouts;
+	atomic_int max_depth;
+	int threads;
+	
+	/* These are the problem domain functions required by mcts */
+	Filo  *(*actions_fn)    (STATE *state);
+	STATE *(*result)        (ACTION *a, STATE *state);
+	bool   (*terminal_test) (STATE *state);
+	Filo  *(*successors)    (STATE *state);
+	STATE *(*playout_step)  (STATE *state, unsigned int *seed);
+	int    (*outcome)       (STATE *state, STATE *root);
+	bool   (*equal)         (STATE *a, STATE *b);
+	STATE *(*copy)          (STATE *state);
+	void   (*set_estimate)  (ACTION *a, int estimate);
+	void   (*free_action)   (ACTION *a);
+	void   (*free_state)    (STATE *state);
+} Tree;
+
+struct MctsTree {						/* Part of a tree kept for a game's next search	      */
+	Node *nodes;						/* Root at 0, children are contiguous		      */
+	int n_nodes;
+	void (*free_state)(STATE *state);
+};
+
+/* ********** *
+ * Prototypes *
+ * ********** */
+PUBLIC ACTION *mcts_decision     (STATE *state);
+PUBLIC void    mcts_init         (int time, int threads, Filo *(*actions)(STATE *state),
+				  STATE *(*result)(ACTION *a, STATE *state), bool (*terminal_test)(STATE *state),
+				  Filo *(*successors)(STATE *state),
+				  STATE *(*playout_step)(STATE *state, unsigned int *seed),
+				  int (*outcome)(STATE *state, STATE *root), bool (*equal)(STATE *a, STATE *b),
+				  STATE *(*copy)(STATE *state), void (*set_estimate)(ACTION *a, int estimate),
+				  void (*free_action)(ACTION *a), void (*free_state)(STATE *state));
+PUBLIC void    mcts_set_stop     (atomic_bool *stop);
+PUBLIC void    mcts_set_tree     (MctsTree **kept);
+PUBLIC void    mcts_free_tree    (MctsTree *kept);
+PUBLIC int     mcts_get_depth    (void);
+PUBLIC int     mcts_get_playouts (void);
+
+PRIVATE void  *search_thread (void *arg);
+PRIVATE void   iterate       (Tree *tree, unsigned int *seed);
+PRIVATE int    select_child  (Tree *tree, Node *parent);
+PRIVATE void   expand        (Tree *tree, Node *node, Filo *children, bool root);
+PRIVATE void   init_node     (Node *node, bool root_moved);
+PRIVATE int    playout       (Tree *tree, Node *node, unsigned int *seed);
+PRIVATE bool   reuse         (Tree *tree, STATE *state);
+PRIVATE int    move_subtree  (Tree *tree, Pool *to, int from, int to_index);
+PRIVATE bool   attach_actions(Tree *tree, STATE *state);
+PRIVATE void   restore_kept  (Tree *tree, MctsTree *kept);
+PRIVATE MctsTree *keep_subtree (Tree *tree, int from);
+PRIVATE void   clear_pool    (Tree *tree, Pool *pool);
+PRIVATE int    alloc_nodes   (Pool *pool, int n);
+PRIVATE bool   expired       (Tree *tree);
+
+/* ******* *
+ * Globals *
+ * ******* */
+PRIVATE __thread Tree *mcts_tree = NULL;				/* This thread's tree, kept between searches  */
+PRIVATE __thread bool  ready = false;					/* True if mcts_init run correctly	      */
+PRIVATE __thread int   last_depth = 0;					/* Depth reached by last mcts_decision()      */
+PRIVATE __thread int   last_playouts = 0;				/* Playouts run by last mcts_decision()	      */
+
+/* ********* *
+ * Functions *
+ * ********* */
+/*
+ * Sets required values for mcts. Must be called before mcts_decision(). time is in milliseconds.
+ */
+PUBLIC void mcts_init(int time, int threads, Filo *(*actions)(STATE *state),
+		      STATE *(*result)(ACTION *a, STATE *state), bool (*terminal_test)(STATE *state),
+		      Filo *(*successors)(STATE *state), STATE *(*playout_step)(STATE *state, unsigned int *seed),
+		      int (*outcome)(STATE *state, STATE *root), bool (*equal)(STATE *a, STATE *b),
+		      STATE *(*copy)(STATE *state), void (*set_estimate)(ACTION *a, int estimate),
+		      void (*free_action)(ACTION *a), void (*free_state)(STATE *state)) {
+	Tree *tree;
+	
+	/* Check for valid args */
+	ready = false;
+	if (time <= 0 || threads <= 0 || !actions || !result || !terminal_test || !successors || !playout_step
+	    || !outcome || !equal || !copy || !set_estimate || !free_action || !free_state) return;
+	
+	/* Create this thread's tree on first use */
+	if (mcts_tree == NULL) {
+		tree = (Tree *)calloc(1, sizeof(Tree));
+		tree->pools[0].nodes = (Node *)calloc(POOL_SIZE, sizeof(Node));
+		tree->pools[1].nodes = (Node *)calloc(POOL_SIZE, sizeof(Node));
+		if (!tree->pools[0].nodes || !tree->pools[1].nodes) {
+			free(tree->pools[0].nodes);
+			free(tree->pools[1].nodes);
+			free(tree);
+			return;
+		}
+		mcts_tree = tree;
+	}
+	tree = mcts_tree;
+	
+	/* Use provided functions as the problem domain functions for this search */
+	clock_gettime(CLOCK_MONOTONIC, &(tree->deadline));
+	tree->deadline.tv_sec += time / 1000;
+	tree->deadline.tv_nsec += (long)(time % 1000) * 1000000;
+	if (tree->deadline.tv_nsec >= 1000000000) {
+		tree->deadline.tv_sec++;
+		tree->deadline.tv_nsec -= 1000000000;
+	}
+	tree->threads       = (threads > MAX_THREADS) ? MAX_THREADS : threads;
+	tree->stop_flag     = NULL;
+	tree->kept          = NULL;
+	tree->actions_fn    = actions;
+	tree->result        = result;
+	tree->terminal_test = terminal_test;
+	tree->successors    = successors;
+	tree->playout_step  = playout_step;
+	tree->outcome       = outcome;
+	tree->equal         = equal;
+	tree->copy          = copy;
+	tree->set_estimate  = set_estimate;
+	tree->free_action   = free_action;
+	tree->free_state    = free_state;
+	
+	ready = true;
+}
+
+/*
+ * Sets a flag which ends the current search once it is set true. Must be called after mcts_init().
+ */
+PUBLIC void mcts_set_stop(atomic_bool *stop) {
+	if (ready) mcts_tree->stop_flag = stop;
+}
+
+/*
+ * Has the current search start from the tree in *kept, if any, and leave the subtree of its chosen move there for the 
+ * next search of the same game, instead of using this thread's tree. Must be called after mcts_init().
+ */
+PUBLIC void mcts_set_tree(MctsTree **kept) {
+	if (ready) mcts_tree->kept = kept;
+}
+
+/*
+ * Frees a tree kept by mcts_set_tree(), and the states in it.
+ */
+PUBLIC void mcts_free_tree(MctsTree *kept) {
+	int i;
+	
+	if (kept == NULL) return;
+	for (i = 0; i < kept->n_nodes; i++) if (kept->nodes[i].state) kept->free_state(kept->nodes[i].state);
+	free(kept->nodes);
+	free(kept);
+}
+
+/*
+ * Start an MCTS search with STATE *state as the initial state. Returns best action found by this search.
+ */
+PUBLIC ACTION *mcts_decision(STATE *state) {
+	Tree *tree = mcts_tree;
+	Pool *pool;
+	Node *root, *child, *best = NULL;
+	ACTION *a, *other;
+	pthread_t helpers[MAX_THREADS];
+	unsigned int seed;
+	int i, n_helpers = 0;
+	
+	/* Need to have problem domain functions before starting a search */
+	if (!ready) return NULL;
+	
+	last_depth = 0;
+	last_playouts = 0;
+	atomic_init(&(tree->playouts), 0);
+	atomic_init(&(tree->max_depth), 0);
+	
+	/* Get possible actions */
+	tree->actions = tree->actions_fn(state);
+	if (filo_isEmpty(&(tree->actions))) return NULL;
+	
+	/* A game's kept tree replaces this thread's, which belongs to another search */
+	if (tree->kept) {
+		clear_pool(tree, &(tree->pools[tree->current]));
+		restore_kept(tree, *(tree->kept));
+		*(tree->kept) = NULL;
+	}
+	
+	/* Keep the part of the last tree below this state, else start a new tree */
+	if (!reuse(tree, state) || !attach_actions(tree, state)) {
+		pool = &(tree->pools[tree->current]);
+		clear_pool(tree, pool);
+		alloc_nodes(pool, 1);
+		init_node(&(pool->nodes[0]), false);
+		pool->nodes[0].state = tree->copy(state);
+		expand(tree, &(pool->nodes[0]), tree->actions, true);
+	}
+	if (tree->root_state) tree->free_state(tree->root_state);
+	tree->root_state = tree->copy(state);
+	
+	/* Search on this thread and helper threads until time runs out */
+	for (i = 1; i < tree->threads; i++) {
+		if (pthread_create(&helpers[n_helpers], NULL, search_thread, tree) == 0) n_helpers++;
+	}
+	seed = (unsigned int)time(NULL);
+	while (!expired(tree)) iterate(tree, &seed);
+	for (i = 0; i < n_helpers; i++) pthread_join(helpers[i], NULL);
+	
+	/* Choose the most visited child of the root */
+	root = &(tree->pools[tree->current].nodes[0]);
+	for (i = 0; i < root->n_children; i++) {
+		child = &(tree->pools[tree->current].nodes[root->first_child + i]);
+		if (best == NULL || atomic_load(&(child->visits)) > atomic_load(&(best->visits))) best = child;
+	}
+	if (atomic_load(&(best->visits)) > 0) {
+		tree->set_estimate(best->action, (int)(atomic_load(&(best->margin)) / atomic_load(&(best->visits))));
+	}
+	
+	last_depth = atomic_load(&(tree->max_depth));
+	last_playouts = atomic_load(&(tree->playouts));
+	
+	/* Give the chosen move's subtree to the game, and drop the rest as this thread's tree has lost part of it */
+	if (tree->kept) {
+		*(tree->kept) = keep_subtree(tree, best - root);
+		clear_pool(tree, &(tree->pools[tree->current]));
+	}
+	
+	/* Free actions which were not chosen */
+	a = best->action;
+	while (!filo_isEmpty(&(tree->actions))) {
+		other = filo_pop(&(tree->actions));
+		if (other != a) tree->free_action(other);
+	}
+	for (i = 0; i < root->n_children; i++) tree->pools[tree->current].nodes[root->first_child + i].action = NULL;
+	
+	return a;
+}
+
+/*
+ * Returns the depth of the deepest node reached by the last call to mcts_decision().
+ */
+PUBLIC int mcts_get_depth(void) {
+	return last_depth;
+}
+
+/*
+ * Returns the number of playouts run by the last call to mcts_decision().
+ */
+PUBLIC int mcts_get_playouts(void) {
+	return last_playouts;
+}
+
+/*
+ * Runs iterations of a search on a helper thread until time runs out.
+ */
+PRIVATE void *search_thread(void *arg) {
+	Tree *tree = (Tree *)arg;
+	unsigned int seed = (unsigned int)time(NULL) ^ (unsigned int)(size_t)&seed;
+	
+	while (!expired(tree)) iterate(tree, &seed);
+	
+	return NULL;
+}
+
+/*
+ * Runs one iteration of the search: selects a path from the root to a leaf, expands the leaf if it has been visited
+ * enough, runs a playout from it and backs up the result along the path.
+ */
+PRIVATE void iterate(Tree *tree, unsigned int *seed) {
+	Pool *pool = &(tree->pools[tree->current]);
+	Node *node;
+	Filo *children;
+	int path[MAX_PATH], length = 0, index = 0, result, points, expected, depth, i;
+	
+	/* Select, adding a virtual loss to each node on the path */
+	node = &(pool->nodes[0]);
+	atomic_fetch_add(&(node->visits), VIRTUAL_LOSS);
+	path[length++] = 0;
+	while (atomic_load_explicit(&(node->status), memory_order_acquire) == EXPANDED && length < MAX_PATH) {
+		index = select_child(tree, node);
+		node = &(pool->nodes[index]);
+		atomic_fetch_add(&(node->visits), VIRTUAL_LOSS);
+		path[length++] = index;
+	}
+	
+	/* Expand a leaf which has been visited enough, unless another thread is already expanding it */
+	expected = LEAF;
+	if (atomic_load(&(node->visits)) >= EXPAND_VISITS + VIRTUAL_LOSS
+	    && atomic_compare_exchange_strong(&(node->status), &expected, EXPANDING)) {
+		if (tree->terminal_test(node->state)) {
+			atomic_store_explicit(&(node->status), TERMINAL, memory_order_release);
+		} else {
+			children = tree->successors(node->state);
+			expand(tree, node, children, false);
+		}
+	}
+	
+	/* Play out and back up result */
+	result = playout(tree, node, seed);
+	for (i = 0; i < length; i++) {
+		node = &(pool->nodes[path[i]]);
+		if (result == 0) points = 1;
+		else points = ((result > 0) == node->root_moved) ? 2 : 0;
+		atomic_fetch_add(&(node->points), points);
+		atomic_fetch_add(&(node->margin), (node->root_moved) ? result : -result);
+		atomic_fetch_add(&(node->visits), 1 - VIRTUAL_LOSS);
+	}
+	
+	/* Record stats */
+	atomic_fetch_add(&(tree->playouts), 1);
+	depth = length - 1;
+	expected = atomic_load(&(tree->max_depth));
+	while (depth > expected && !atomic_compare_exchange_weak(&(tree->max_depth), &expected, depth));
+}
+
+/*
+ * Returns the index of the child with the highest UCT value. Unvisited children are chosen first.
+ */
+PRIVATE int select_child(Tree *tree, Node *parent) {
+	Node *nodes = tree->pools[tree->current].nodes, *child;
+	double log_visits, value, best_value = -1.0;
+	int i, visits, best = parent->first_child;
+	
+	log_visits = log((double)atomic_load(&(parent->visits)));
+	for (i = parent->first_child; i < parent->first_child + parent->n_children; i++) {
+		child = &nodes[i];
+		visits = atomic_load(&(child->visits));
+		if (visits == 0) return i;
+	
+		value = atomic_load(&(child->points)) / (2.0 * visits) + EXPLORATION * sqrt(log_visits / visits);
+		if (value > best_value) {
+			best_value = value;
+			best = i;
+		}
+	}
+	
+	return best;
+}
+
+/*
+ * Gives a node the states in children as its child nodes, consuming the Filo. For the root, children is a
+ * Filo<ACTION> of the root's actions instead, which is not consumed. If the pool is full the node is left a leaf.
+ */
+PRIVATE void expand(Tree *tree, Node *node, Filo *children, bool root) {
+	Pool *pool = &(tree->pools[tree->current]);
+	Filo *list = children;
+	Node *child;
+	bool root_moves;
+	int n, first, i;
+	
+	n = filo_size(&list);
+	list = children;
+	
+	first = alloc_nodes(pool, n);
+	if (first < 0) {						/* Pool full, stay a leaf		      */
+		if (!root) while (!filo_isEmpty(&list)) tree->free_state(filo_pop(&list));
+		atomic_store(&(node->status), LEAF);
+		return;
+	}
+	
+	/* Players alternate down the tree (a pass is a move), so the player at root moves into every other ply */
+	root_moves = (node == &(pool->nodes[0])) ? true : !node->root_moved;
+	
+	for (i = 0; i < n; i++) {
+		child = &(pool->nodes[first + i]);
+		init_node(child, root_moves);
+		if (root) {
+			child->action = list->value;
+			child->state = tree->copy(tree->result(child->action, node->state));
+			list = list->next;
+		} else child->state = filo_pop(&list);
+	}
+	
+	node->first_child = first;
+	node->n_children = n;
+	atomic_store_explicit(&(node->status), EXPANDED, memory_order_release);
+}
+
+/*
+ * Resets a node's fields, leaving its state unset.
+ */
+PRIVATE void init_node(Node *node, bool root_moved) {
+	node->action = NULL;
+	node->first_child = 0;
+	node->n_children = 0;
+	node->root_moved = root_moved;
+	atomic_init(&(node->status), LEAF);
+	atomic_init(&(node->visits), 0);
+	atomic_init(&(node->points), 0);
+	atomic_init(&(node->margin), 0);
+}
+
+/*
+ * Plays random moves from a node's state to the end of the game. Returns the outcome for the player to move at root.
+ */
+PRIVATE int playout(Tree *tree, Node *node, unsigned int *seed) {
+	STATE *state, *next;
+	int result;
+	
+	if (atomic_load(&(node->status)) == TERMINAL) return tree->outcome(node->state, tree->root_state);
+	
+	state = tree->copy(node->state);
+	while ((next = tree->playout_step(state, seed)) != NULL) {
+		tree->free_state(state);
+		state = next;
+	}
+	result = tree->outcome(state, tree->root_state);
+	tree->free_state(state);
+	
+	return result;
+}
+
+/*
+ * Makes the node of the last tree whose state is state, if it is in the top two plies, the root of the tree. Returns
+ * false if there is no such node.
+ */
+PRIVATE bool reuse(Tree *tree, STATE *state) {
+	Pool *from = &(tree->pools[tree->current]), *to = &(tree->pools[1 - tree->current]);
+	Node *nodes = from->nodes, *child;
+	int found = -1, i, j;
+	
+	if (atomic_load(&(from->used)) == 0) return false;
+	
+	/* Look for state in top two plies */
+	if (tree->equal(nodes[0].state, state)) found = 0;
+	for (i = 0; found < 0 && i < nodes[0].n_children; i++) {
+		child = &nodes[nodes[0].first_child + i];
+		if (tree->equal(child->state, state)) found = nodes[0].first_child + i;
+		if (atomic_load(&(child->status)) != EXPANDED) continue;
+		for (j = 0; found < 0 && j < child->n_children; j++) {
+			if (tree->equal(nodes[child->first_child + j].state, state)) found = child->first_child + j;
+		}
+	}
+	if (found < 0) return false;
+	
+	/* Move subtree to the other pool, then free the rest of this one */
+	clear_pool(tree, to);
+	alloc_nodes(to, 1);
+	move_subtree(tree, to, found, 0);
+	clear_pool(tree, from);
+	tree->current = 1 - tree->current;
+	
+	/* A player's outcome is now seen from the new root */
+	to->nodes[0].root_moved = false;
+	return true;
+}
+
+/*
+ * Moves node from, and all its descendants, from the current pool to node to_index of pool to. Returns to_index.
+ */
+PRIVATE int move_subtree(Tree *tree, Pool *to, int from, int to_index) {
+	Node *old = &(tree->pools[tree->current].nodes[from]), *new = &(to->nodes[to_index]);
+	int first, i;
+	
+	init_node(new, old->root_moved);
+	new->state = old->state;
+	old->state = NULL;						/* State now belongs to new node	      */
+	atomic_init(&(new->visits), atomic_load(&(old->visits)));
+	atomic_init(&(new->points), atomic_load(&(old->points)));
+	atomic_init(&(new->margin), atomic_load(&(old->margin)));
+	atomic_init(&(new->status), atomic_load(&(old->status)));
+	
+	if (atomic_load(&(old->status)) == EXPANDED) {
+		first = alloc_nodes(to, old->n_children);
+		new->first_child = first;
+		new->n_children = old->n_children;
+		for (i = 0; i < old->n_children; i++) move_subtree(tree, to, old->first_child + i, first + i);
+	}
+	
+	return to_index;
+}
+
+/*
+ * Gives the root's children the root's actions, matching them by state, and fixes which player moved into each node
+ * now that the root may have changed. Returns false if the children and actions don't match.
+ */
+PRIVATE bool attach_actions(Tree *tree, STATE *state) {
+	Pool *pool = &(tree->pools[tree->current]);
+	Node *root = &(pool->nodes[0]), *child;
+	Filo *list;
+	int i, matched = 0;
+	bool flip;
+	
+	list = tree->actions;
+	if (atomic_load(&(root->status)) != EXPANDED || root->n_children != filo_size(&list)) return false;
+	
+	for (i = 0; i < root->n_children; i++) {
+		child = &(pool->nodes[root->first_child + i]);
+		child->action = NULL;
+		for (list = tree->actions; !filo_isEmpty(&list); list = list->next) {
+			if (tree->equal(child->state, tree->result(list->value, state))) {
+				child->action = list->value;
+				matched++;
+				break;
+			}
+		}
+	}
+	if (matched != root->n_children) return false;
+	
+	/* Children of the root must be moved into by the root player */
+	flip = !pool->nodes[root->first_child].root_moved;
+	if (flip) {
+		for (i = 1; i < atomic_load(&(pool->used)); i++) pool->nodes[i].root_moved = !pool->nodes[i].root_moved;
+	}
+	
+	return true;
+}
+
+/*
+ * Copies a game's kept tree, if not NULL, into the empty current pool and frees it. Its states now belong to the pool.
+ */
+PRIVATE void restore_kept(Tree *tree, MctsTree *kept) {
+	Pool *pool = &(tree->pools[tree->current]);
+	
+	if (kept == NULL) return;
+	memcpy(pool->nodes, kept->nodes, kept->n_nodes * sizeof(Node));
+	atomic_store(&(pool->used), kept->n_nodes);
+	free(kept->nodes);
+	free(kept);
+}
+
+/*
+ * Moves node from, and as many of its descendants as fit in KEEP_NODES, out of the current pool into a new kept tree. 
+ * Nodes are taken breadth first, so the plies nearest the root are kept, and a node whose children don't all fit is 
+ * kept as a leaf. Returns NULL if memory runs out.
+ */
+PRIVATE MctsTree *keep_subtree(Tree *tree, int from) {
+	Node *nodes = tree->pools[tree->current].nodes, *old, *new, *fit;
+	MctsTree *kept;
+	int source[KEEP_NODES], n = 1, i, c;
+	
+	kept = (MctsTree *)malloc(sizeof(MctsTree));
+	if (kept == NULL || (kept->nodes = (Node *)malloc(KEEP_NODES * sizeof(Node))) == NULL) {
+		free(kept);
+		return NULL;
+	}
+	kept->free_state = tree->free_state;
+	
+	source[0] = from;
+	for (i = 0; i < n; i++) {
+		old = &nodes[source[i]];
+		new = &(kept->nodes[i]);
+		init_node(new, old->root_moved);
+		new->state = old->state;
+		old->state = NULL;					/* State now belongs to kept tree	      */
+		atomic_init(&(new->visits), atomic_load(&(old->visits)));
+		atomic_init(&(new->points), atomic_load(&(old->points)));
+		atomic_init(&(new->margin), atomic_load(&(old->margin)));
+		if (atomic_load(&(old->status)) == TERMINAL) atomic_init(&(new->status), TERMINAL);
+		
+		if (atomic_load(&(old->status)) == EXPANDED && n + old->n_children <= KEEP_NODES) {
+			atomic_init(&(new->status), EXPANDED);
+			new->first_child = n;
+			new->n_children = old->n_children;
+			for (c = 0; c < old->n_children; c++) source[n++] = old->first_child + c;
+		}
+	}
+	
+	kept->n_nodes = n;
+	if ((fit = (Node *)realloc(kept->nodes, n * sizeof(Node))) != NULL) kept->nodes = fit;	/* Shrink to fit */
+	
+	return kept;
+}
+
+/*
+ * Frees the states of every node in a pool and empties it.
+ */
+PRIVATE void clear_pool(Tree *tree, Pool *pool) {
+	int i, used = atomic_load(&(pool->used));
+	
+	if (used > POOL_SIZE) used = POOL_SIZE;
+	for (i = 0; i < used; i++) {
+		if (pool->nodes[i].state) tree->free_state(pool->nodes[i].state);
+		pool->nodes[i].state = NULL;
+	}
+	atomic_store(&(pool->used), 0);
+}
+
+/*
+ * Allocates n contiguous nodes from a pool. Returns the index of the first, or -1 if the pool is full.
+ */
+PRIVATE int alloc_nodes(Pool *pool, int n) {
+	int first = atomic_fetch_add(&(pool->used), n);
+	
+	if (first + n > POOL_SIZE) return -1;
+	return first;
+}
+
+/*
+ * Checks if the search has run out of time or been asked to stop.
+ */
+PRIVATE bool expired(Tree *tree) {
+	struct timespec now;
+	
+	if (tree->stop_flag && atomic_load(tree->stop_flag)) return true;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	return (now.tv_sec > tree->deadline.tv_sec)
+	       || (now.tv_sec == tree->deadline.tv_sec && now.tv_nsec >= tree->deadline.tv_nsec);
+}
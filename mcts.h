@@ -0,0 +1,52 @@
+/* ****************************************************************************************************************** *
+ * Name:	mcts.h
+ * Description:	Header file for mcts.c
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+#ifndef _MCTS_H
+#define _MCTS_H
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "filo.h"
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define STATE	void
+#define ACTION	void
+
+/* ******** *
+ * Typedefs *
+ * ******** */
+typedef struct MctsTree MctsTree;				/* Part of a tree kept for a game's next search	      */
+
+/* ********** *
+ * Prototypes *
+ * ********** */
+extern ACTION *mcts_decision  (STATE *state);				/* Start an MCTS search. Returns best action  */
+extern void    mcts_init      (int time, int threads,			/* Sets values for mcts, time in ms	      */
+			       Filo *(*actions)(STATE *state),
+			       STATE *(*result)(ACTION *a, STATE *state),
+			       bool (*terminal_test)(STATE *state),
+			       Filo *(*successors)(STATE *state),
+			       STATE *(*playout_step)(STATE *state, unsigned int *seed),
+			       int (*outcome)(STATE *state, STATE *root),
+			       bool (*equal)(STATE *a, STATE *b),
+			       STATE *(*copy)(STATE *state),
+			       void (*set_estimate)(ACTION *a, int estimate),
+			       void (*free_action)(ACTION *a),
+			       void (*free_state)(STATE *state));
+extern void    mcts_set_stop  (atomic_bool *stop);			/* Flag which ends the search when set true   */
+extern void    mcts_set_tree  (MctsTree **kept);			/* Keeps a game's tree between its searches   */
+extern void    mcts_free_tree (MctsTree *kept);				/* Frees a kept tree			      */
+extern int     mcts_get_depth (void);					/* Returns deepest node reached by last search */
+extern int     mcts_get_playouts (void);				/* Returns playouts run by last search	      */
+
+#endif
@@ -29,6 +29,36 @@
  * 		A search is started by calling minmax_decision() with the initial state of this search.
  * 		Important! minmaxsearch_init() must be run before minmax_decision() with valid arguments.
  * 
+ * 		Optionally, after minmaxsearch_init() a progress(ACTION, depth) callback may be given with 
+ * 		minmaxsearch_set_progress(), which is called with the best action each time a depth is completed, 
+ * 		and a stop flag may be given with minmaxsearch_set_stop(). Setting the stop flag true (eg. from 
+ * 		another thread) ends the search at the next node visited, as if the time limit had expired.
+ * 
+ * 		A store of solved positions may also be given with minmaxsearch_set_solved():
+ * 			probe(STATE, Filo<ACTION>, &ACTION, &value)
+ * 				Finds a solved state, returning true and setting the best of the given actions and the 
+ * 				state's exact value if it has been solved.
+ * 			store(STATE, ACTION, value)
+ * 				Records the best action and exact value of a state which has been solved.
+ * 		minmax_decision() returns the probed action without searching if the initial state has been solved, 
+ * 		and stores the initial state if its search finishes before the time limit.
+ * 
+ * 		A transposition table may be given with minmaxsearch_set_table(), along with a hash(STATE) function 
+ * 		for it. States found in the table which have been searched deep enough are not searched again.
+ * 
+ * 		A bounds(STATE, depth, alpha, beta, &lower, &upper) function may be given with 
+ * 		minmaxsearch_set_bounds(). If it returns true, lower and upper must bound the value of any search of 
+ * 		the state to the given depth. A state whose bounds fall outside (alpha, beta) is not searched (eg. a 
+ * 		stability cutoff in othello). bounds() may return false without finding bounds if they can't fall 
+ * 		outside (alpha, beta), so slow bounds are only found where they can cut.
+ * 		
+ * 		An equivalent(STATE, STATE) function may be given with minmaxsearch_set_equivalent(), which returns 
+ * 		true if two states must have the same value (eg. they are symmetric). minmax_decision() then only 
+ * 		searches the first of any root actions whose results are equivalent.
+ * 
+ * 		All search state is thread local, so searches may run on several threads at once. Each thread must 
+ * 		call minmaxsearch_init() itself.
+ * 
  * 		minmaxsearch will find an optimal solution iff it completes its search within the time specified to 
  * 		minmaxsearch_init(). Otherwise it will return the best solution found so far.
  * 
@@ -47,6 +77,7 @@
 #include <time.h>
 
 #include "minmaxsearch.h"
+#include "profile.h"
 
 /* ******* *
  * Defines *
@@ -59,38 +90,62 @@
  * ********** */
 extern int max_value(STATE *state, int alpha, int beta, int depth);
 extern int min_value(STATE *state, int alpha, int beta, int depth);
+extern bool table_probe(uint64_t key, int alpha, int beta, int depth, int *v);
+extern bool bounds_cutoff(STATE *state, int alpha, int beta, int depth, int *v);
+extern Filo *unique_actions(STATE *state, Filo *actions);
+extern void table_store(uint64_t key, int alpha, int beta, int depth, int v);
+extern bool expired(void);
  
 /* ******* *
  * Globals *
  * ******* */
-bool   ready = false;							/* True if minmaxsearch_init run correctly    */
-int    depth_limit = 0;							/* Depth reached by last minmax_decision()    */
-bool   done;								/* Optimal solution found before time limit   */
-double time_limit;							/* Time constraint on minmaxsearch	      */
-time_t start_time;							/* Time search started			      */
-bool   timeout;								/* Search timed out			      */
+/* Searches on different threads are independent, so all search state is thread local */
+__thread bool   ready = false;						/* True if minmaxsearch_init run correctly    */
+__thread int    depth_limit = 0;					/* Depth reached by last minmax_decision()    */
+__thread bool   done;							/* Optimal solution found before time limit   */
+__thread int    time_limit;						/* Milliseconds allowed for minmaxsearch      */
+__thread struct timespec deadline;					/* Time search must end by		      */
+__thread bool   timeout;						/* Search timed out			      */
+__thread atomic_bool *stop_flag = NULL;					/* Ends search when set true		      */
+__thread TTable *mmsearch_table = NULL;					/* Table of searched states, may be shared    */
 
 /* These are the problem domain functions required by minmaxsearch */
-Filo  *(*mmsearch_actions)       (STATE *state)            = NULL;	/* Finds possible actions for a state	      */
-STATE *(*mmsearch_result)        (ACTION *a, STATE *state) = NULL;	/* Returns result of an action on a state     */
-int    (*mmsearch_utility)       (STATE *state)            = NULL;	/* Returns utility value for a state	      */
-bool   (*mmsearch_terminal_test) (STATE *state)            = NULL;	/* Tests for a terminal state		      */
-Filo  *(*mmsearch_successors)    (STATE *state)            = NULL;	/* Expands a state			      */
-void   (*mmsearch_set_estimate)  (ACTION *a, int estimate) = NULL;	/* Updates minmax estimate of an action	      */
-void   (*mmsearch_free_action)   (ACTION *a)               = NULL;	/* Safely frees an action		      */
-void   (*mmsearch_free_state)    (STATE *a)                = NULL;	/* Safely frees a state			      */
+__thread Filo  *(*mmsearch_actions)       (STATE *state)            = NULL;	/* Finds possible actions for a state	      */
+__thread STATE *(*mmsearch_result)        (ACTION *a, STATE *state) = NULL;	/* Returns result of an action on a state     */
+__thread int    (*mmsearch_utility)       (STATE *state)            = NULL;	/* Returns utility value for a state	      */
+__thread bool   (*mmsearch_terminal_test) (STATE *state)            = NULL;	/* Tests for a terminal state		      */
+__thread Filo  *(*mmsearch_successors)    (STATE *state)            = NULL;	/* Expands a state			      */
+__thread void   (*mmsearch_set_estimate)  (ACTION *a, int estimate) = NULL;	/* Updates minmax estimate of an action	      */
+__thread void   (*mmsearch_free_action)   (ACTION *a)               = NULL;	/* Safely frees an action		      */
+__thread void   (*mmsearch_free_state)    (STATE *a)                = NULL;	/* Safely frees a state			      */
+__thread void   (*mmsearch_progress)      (ACTION *a, int depth)    = NULL;	/* Reports best action at each depth	      */
+__thread bool   (*mmsearch_probe)         (STATE *state, Filo *actions, ACTION **best, int *value) = NULL;	/* Finds solved */
+__thread void   (*mmsearch_store)         (STATE *state, ACTION *best, int value) = NULL;	/* Records a solved state     */
+__thread uint64_t (*mmsearch_hash)       (STATE *state)            = NULL;	/* Hashes a state for the table	      */
+__thread bool   (*mmsearch_bounds)        (STATE *state, int depth, int alpha, int beta, int *lower, int *upper) = NULL;
+__thread bool   (*mmsearch_equivalent)    (STATE *a, STATE *b)      = NULL;	/* Tests if states have same value    */
 
 /* ********* *
  * Functions *
  * ********* */
 /*
- * Sets required values for minmaxsearch. Must be called before minmax_decision().
+ * Sets required values for minmaxsearch. Must be called before minmax_decision(). time is in milliseconds.
  */
 void minmaxsearch_init(int time, Filo *(*actions)(STATE *state), STATE *(*result)(ACTION *a, STATE *state), 
 		       int (*utility)(STATE *state), bool (*terminal_test)(STATE *state), 
 		       Filo *(*successors)(STATE *state), void (*set_estimate)(ACTION *a, int estimate),
 		       void(*free_action)(ACTION *a), void(*free_state)(STATE *state)) {
 		       
+	/* Optional hooks must be set again for each search */
+	mmsearch_progress = NULL;
+	mmsearch_probe = NULL;
+	mmsearch_store = NULL;
+	mmsearch_table = NULL;
+	mmsearch_hash = NULL;
+	mmsearch_bounds = NULL;
+	mmsearch_equivalent = NULL;
+	stop_flag = NULL;
+	
 	/* Check for valid args */
 	if (time <= 0 || !actions || !result || !utility || !terminal_test || !successors || !set_estimate 
 	    || !free_action || !free_state) {
@@ -99,7 +154,7 @@ void minmaxsearch_init(int time, Filo *(*actions)(STATE *state), STATE *(*result
 	}
 	
 	/* Use provided functions as the problem domain functions for this search */
-	time_limit             = (double)time;
+	time_limit             = time;
 	mmsearch_actions       = actions;
 	mmsearch_result        = result;
 	mmsearch_utility       = utility;
@@ -112,6 +167,54 @@ void minmaxsearch_init(int time, Filo *(*actions)(STATE *state), STATE *(*result
 	ready = true;
 }
 
+/*
+ * Sets a callback which is given the best action found so far each time a depth is completed. Must be called after 
+ * minmaxsearch_init().
+ */
+void minmaxsearch_set_progress(void (*progress)(ACTION *a, int depth)) {
+	mmsearch_progress = progress;
+}
+
+/*
+ * Sets a flag which ends the current search at the next node visited once it is set true. Must be called after 
+ * minmaxsearch_init().
+ */
+void minmaxsearch_set_stop(atomic_bool *stop) {
+	stop_flag = stop;
+}
+
+/*
+ * Sets the functions used to look up and record solved states. Must be called after minmaxsearch_init().
+ */
+void minmaxsearch_set_solved(bool (*probe)(STATE *state, Filo *actions, ACTION **best, int *value),
+			     void (*store)(STATE *state, ACTION *best, int value)) {
+	mmsearch_probe = probe;
+	mmsearch_store = store;
+}
+
+/*
+ * Sets a transposition table, which may be shared with searches on other threads, and the function used to hash 
+ * states for it. Hashes must also differ for states whose utility() differs. Must be called after minmaxsearch_init().
+ */
+void minmaxsearch_set_table(TTable *table, uint64_t (*hash)(STATE *state)) {
+	mmsearch_table = (hash) ? table : NULL;
+	mmsearch_hash = hash;
+}
+
+/*
+ * Sets the function used to bound the value of a state before searching it. Must be called after minmaxsearch_init().
+ */
+void minmaxsearch_set_bounds(bool (*bounds)(STATE *state, int depth, int alpha, int beta, int *lower, int *upper)) {
+	mmsearch_bounds = bounds;
+}
+
+/*
+ * Sets the function used to find root actions with equivalent results. Must be called after minmaxsearch_init().
+ */
+void minmaxsearch_set_equivalent(bool (*equivalent)(STATE *a, STATE *b)) {
+	mmsearch_equivalent = equivalent;
+}
+
 /*
  * Start a minmax search with STATE *state as the initial state. Returns best action found by this search.
  */
@@ -119,20 +222,32 @@ ACTION *minmax_decision(STATE *state) {
 	Filo *actions, *node;
 	ACTION *a, *best = NULL, *curr_best = NULL;
 	int v, alpha, beta, min;
+	bool solved;
 	
 	/* Need to have problem domain functions before starting a search */
 	if (!ready) return NULL;
 	
 	/* Start the clock */
-	start_time = time(&start_time);
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += time_limit / 1000;
+	deadline.tv_nsec += (long)(time_limit % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
 	timeout = false;
 	
 	/* Get possible actions */
 	actions = mmsearch_actions(state);
 	
+	/* Initial state may already have been solved */
+	solved = (mmsearch_probe && mmsearch_probe(state, actions, &best, &v));
+	if (solved) mmsearch_set_estimate(best, v);
+	else if (mmsearch_equivalent) actions = unique_actions(state, actions);	/* Only search one of equivalents */
+	
 	/* Find best action  using iterative deepening */
 	depth_limit = 0;							/* Start at min depth		      */
-	done = false;
+	done = solved;
 	while (!done) {
 		depth_limit++;
 		node = actions;							/* Restart search at root	      */
@@ -163,9 +278,17 @@ ACTION *minmax_decision(STATE *state) {
 		
 		best = curr_best;						/* Update best			      */
 		mmsearch_set_estimate(best, v);					/* Record new minmax estimate	      */
+		if (mmsearch_progress) mmsearch_progress(best, depth_limit);	/* Report completed depth	      */
 	}
 	
 	if (timeout) depth_limit--;
+	else if (!solved && best && mmsearch_store) mmsearch_store(state, best, v);	/* Search was exhaustive   */
+	
+	/* Free actions which were not chosen */
+	while (!filo_isEmpty(&actions)) {
+		a = filo_pop(&actions);
+		if (a != best) mmsearch_free_action(a);
+	}
 	
 	return best;								/* Return best action found	      */
 }
@@ -177,12 +300,13 @@ int max_value(STATE *state, int alpha, int beta, int depth) {
 	Filo *successors;
 	STATE *successor;
 	int min, v = INT_MIN;						/* -INF for int				      */
-	time_t curr_time;
+	int alpha_start = alpha;
+	uint64_t key = 0;
+	bool parent_done, hit;
 	
-	/* Check for timeout */
+	/* Check for timeout or stop request */
 	if (timeout) return INT_MIN;
-	time(&curr_time);
-	if (difftime(curr_time, start_time) >= time_limit) {
+	if (expired() || (stop_flag && atomic_load(stop_flag))) {
 		timeout = true;
 		return INT_MIN;
 	}
@@ -193,11 +317,29 @@ int max_value(STATE *state, int alpha, int beta, int depth) {
 		return mmsearch_utility(state);
 	}
 	
+	/* If this state has been searched deep enough before pass up its value */
+	if (mmsearch_table) {
+		PROFILE_ENTER(PROF_HASH);
+		key = mmsearch_hash(state);
+		hit = table_probe(key, alpha, beta, depth, &v);
+		PROFILE_LEAVE();
+		if (hit) return v;
+	}
+	
+	/* If this state's value can't be inside (alpha, beta) pass up the bound */
+	if (mmsearch_bounds && bounds_cutoff(state, alpha, beta, depth, &v)) return v;
+	
 	/* If terminal state stop searching and pass up value of this state */
-	if (mmsearch_terminal_test(state)) return mmsearch_utility(state);
+	if (mmsearch_terminal_test(state)) {
+		v = mmsearch_utility(state);
+		if (mmsearch_table) tt_store(mmsearch_table, key, v, TT_SOLVED, TT_EXACT);
+		return v;
+	}
 	
 	/* Expand current state */
 	successors = mmsearch_successors(state);
+	parent_done = done;						/* Track if this subtree is done	      */
+	done = true;
 	
 	/* Find max of children */
 	while (!filo_isEmpty(&successors)) {
@@ -206,9 +348,15 @@ int max_value(STATE *state, int alpha, int beta, int depth) {
 		v = MAX(v, min);
 		alpha = MAX(alpha, v);
 		mmsearch_free_state(successor);
-		if (v >= beta) return v;
+		if (v >= beta) break;
 	}
 	
+	/* Free children pruned by beta cut-off */
+	while (!filo_isEmpty(&successors)) mmsearch_free_state(filo_pop(&successors));
+	
+	if (mmsearch_table && !timeout) table_store(key, alpha_start, beta, depth, v);
+	done = parent_done && done;
+	
 	return v;							/* Return max of children		      */
 }
 
@@ -219,12 +367,13 @@ int min_value(STATE *state, int alpha, int beta, int depth) {
 	Filo *successors;
 	STATE *successor;
 	int max, v = INT_MAX;						/* +INF for int				      */
-	time_t curr_time;
+	int beta_start = beta;
+	uint64_t key = 0;
+	bool parent_done, hit;
 	
-	/* Check for timeout */
+	/* Check for timeout or stop request */
 	if (timeout) return INT_MAX;
-	time(&curr_time);
-	if (difftime(curr_time, start_time) >= time_limit) {
+	if (expired() || (stop_flag && atomic_load(stop_flag))) {
 		timeout = true;
 		return INT_MAX;
 	}
@@ -235,11 +384,29 @@ int min_value(STATE *state, int alpha, int beta, int depth) {
 		return mmsearch_utility(state);
 	}
 	
+	/* If this state has been searched deep enough before pass up its value */
+	if (mmsearch_table) {
+		PROFILE_ENTER(PROF_HASH);
+		key = mmsearch_hash(state);
+		hit = table_probe(key, alpha, beta, depth, &v);
+		PROFILE_LEAVE();
+		if (hit) return v;
+	}
+	
+	/* If this state's value can't be inside (alpha, beta) pass up the bound */
+	if (mmsearch_bounds && bounds_cutoff(state, alpha, beta, depth, &v)) return v;
+	
 	/* If terminal state stop searching and pass up value of this state */
-	if (mmsearch_terminal_test(state)) return mmsearch_utility(state);
+	if (mmsearch_terminal_test(state)) {
+		v = mmsearch_utility(state);
+		if (mmsearch_table) tt_store(mmsearch_table, key, v, TT_SOLVED, TT_EXACT);
+		return v;
+	}
 	
 	/* Expand current state */
 	successors = mmsearch_successors(state);
+	parent_done = done;						/* Track if this subtree is done	      */
+	done = true;
 	
 	/* Find min of children */
 	while (!filo_isEmpty(&successors)) {
@@ -248,15 +415,102 @@ int min_value(STATE *state, int alpha, int beta, int depth) {
 		v = MIN(v, max);
 		beta = MIN(beta, v);
 		mmsearch_free_state(successor);
-		if (v <= alpha) return v;
+		if (v <= alpha) break;
 	}
 	
+	/* Free children pruned by alpha cut-off */
+	while (!filo_isEmpty(&successors)) mmsearch_free_state(filo_pop(&successors));
+	
+	if (mmsearch_table && !timeout) table_store(key, alpha, beta_start, depth, v);
+	done = parent_done && done;
+	
 	return v;							/* Return min of children		      */
 }
 
+/*
+ * Looks up a state's key in the transposition table. Returns true, setting v, if the entry was searched at least as 
+ * deep as this state would be and its value is exact or a bound outside (alpha, beta).
+ */
+bool table_probe(uint64_t key, int alpha, int beta, int depth, int *v) {
+	int value, draft, bound;
+	
+	if (!tt_probe(mmsearch_table, key, &value, &draft, &bound)) return false;
+	if (draft < depth_limit - depth) return false;
+	if (bound == TT_LOWER && value < beta) return false;
+	if (bound == TT_UPPER && value > alpha) return false;
+	
+	if (draft != TT_SOLVED) done = false;				/* Value came from a depth limited search     */
+	*v = value;
+	return true;
+}
+
+/*
+ * Frees actions whose results are equivalent to the result of an earlier action, keeping the order of the rest.
+ */
+Filo *unique_actions(STATE *state, Filo *actions) {
+	Filo *kept, *unique, *node;
+	ACTION *a;
+	bool seen;
+	
+	filo_init(&kept);
+	while (!filo_isEmpty(&actions)) {
+		a = filo_pop(&actions);
+		seen = false;
+		for (node = kept; !seen && !filo_isEmpty(&node); node = node->next) {
+			seen = mmsearch_equivalent(mmsearch_result(node->value, state), mmsearch_result(a, state));
+		}
+		if (seen) mmsearch_free_action(a);
+		else filo_push(&kept, a);
+	}
+	
+	/* kept is in reverse order */
+	filo_init(&unique);
+	while (!filo_isEmpty(&kept)) filo_push(&unique, filo_pop(&kept));
+	
+	return unique;
+}
+
+/*
+ * Bounds a state's value. Returns true, setting v to the bound, if the value must be outside (alpha, beta).
+ */
+bool bounds_cutoff(STATE *state, int alpha, int beta, int depth, int *v) {
+	int lower, upper;
+	
+	if (!mmsearch_bounds(state, depth_limit - depth, alpha, beta, &lower, &upper)) return false;
+	
+	if (upper <= alpha) *v = upper;					/* Fails low				      */
+	else if (lower >= beta) *v = lower;				/* Fails high				      */
+	else return false;
+	
+	return true;
+}
+
+/*
+ * Stores a searched state's value in the transposition table. The value is only a bound if it fell outside the 
+ * (alpha, beta) window the state was searched with. States whose whole subtree was searched are stored as solved.
+ */
+void table_store(uint64_t key, int alpha, int beta, int depth, int v) {
+	int bound = TT_EXACT;
+	
+	if (v <= alpha) bound = TT_UPPER;
+	else if (v >= beta) bound = TT_LOWER;
+	
+	tt_store(mmsearch_table, key, v, (done) ? TT_SOLVED : depth_limit - depth, bound);
+}
+
 /*
  * Returns the maximum depth reached by the last call to minmax_decision().
  */
 int minmax_get_depth() {
 	return depth_limit;
 }
+
+/*
+ * Checks the monotonic clock against the search's deadline, which has millisecond resolution unlike time().
+ */
+bool expired(void) {
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec > deadline.tv_sec) || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec);
+}
@@ -12,8 +12,10 @@
  * Includes *
  * ******** */
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #include "filo.h"
+#include "ttable.h"
 
 /* ******* *
  * Defines *
@@ -25,7 +27,7 @@
  * Prototypes *
  * ********** */
 extern ACTION *minmax_decision   (STATE *state);			/* Start a minmax search. Returns best action */
-extern void    minmaxsearch_init (int time,				/* Sets required values for minmaxsearch      */
+extern void    minmaxsearch_init (int time,				/* Sets values for minmaxsearch, time in ms   */
 				  Filo *(*actions)(STATE *state),
 				  STATE *(*result)(ACTION *a, STATE *state),
 				  int (*utility)(STATE *state),
@@ -34,6 +36,14 @@ extern void    minmaxsearch_init (int time,				/* Sets required values for minma
 				  void(*set_estimate)(ACTION *a, int estimate),
 				  void(*free_action)(ACTION *a),
 				  void(*free_state)(STATE *state));
+extern void    minmaxsearch_set_progress (void (*progress)(ACTION *a, int depth));	/* Per-depth callback */
+extern void    minmaxsearch_set_stop     (atomic_bool *stop);	/* Flag which ends the search when set true   */
+extern void    minmaxsearch_set_solved   (bool (*probe)(STATE *state, Filo *actions, ACTION **best, int *value),
+					  void (*store)(STATE *state, ACTION *best, int value));	/* Solved positions */
+extern void    minmaxsearch_set_table    (TTable *table, uint64_t (*hash)(STATE *state));	/* Shared table */
+extern void    minmaxsearch_set_bounds   (bool (*bounds)(STATE *state, int depth, int alpha, int beta,
+							 int *lower, int *upper));	/* Cutoffs before search      */
+extern void    minmaxsearch_set_equivalent (bool (*equivalent)(STATE *a, STATE *b));	/* Same valued states */
 extern int     minmax_get_depth  (void);				/* Returns the last maximum depth reached     */
 
 #endif
@@ -3,6 +3,45 @@
  * Description:	A simple move generator that uses a minmax game tree algorithm to choose an intelligent next move for 
  * 		an AI othello player. To start a search run compute_move(). The search will run untill the optimal 
  * 		solution is found or untill the time limit expires. The best move found so far will then be returned.
+ * 		
+ * 		A search may instead be run on a background thread with compute_move_start(), which reports the best 
+ * 		move found at each completed depth to a progress callback. compute_move_stop() ends the search at 
+ * 		the next node visited and compute_move_wait() collects its result.
+ * 		
+ * 		Search state is thread local, so searches may run on many threads at once, as done by the game host 
+ * 		(-g) which plays many games in one process. All searches share one transposition table. State kept 
+ * 		between the moves of one game (its MCTS tree) is in a Context given to compute_game_move(), so the 
+ * 		game may move between threads. Time limits are in milliseconds.
+ * 		
+ * 		At short time limits the minmax search only reaches a few plies, so a Monte Carlo tree search (mcts.c) 
+ * 		is used instead (-e, -m). Played against each other, MCTS won every game at limits from 20ms to 10s a 
+ * 		move, so auto uses it below MCTS_BELOW seconds and leaves minmax, with its progress reports and exact 
+ * 		endgames, for longer analyses. MCTS searches report no progress, but can be stopped.
+ * 		
+ * 		For large offline jobs, a coordinator (-d) reads many boards from stdin and sends them to worker 
+ * 		processes, either forked locally or listening on other hosts (-l), using distrib. With -r the root 
+ * 		moves of each board are sent as separate jobs instead, sharing the board's time between them. Boards
+ * 		which aren't valid are reported and get no move.
+ * 		
+ * 		Positions which are solved exactly are kept in an on-disk database given with -b, shared with other 
+ * 		runs and processes, so that they are never searched twice.
+ * 		
+ * 		Near the end, discs which can never be flipped bound the final score, letting the search cut off 
+ * 		positions whose bounds fall outside its window. stable_discs() counts them for other evaluations, and 
+ * 		with -S they are also weighted in utility().
+ * 		
+ * 		Root moves whose results are symmetric under the 8 symmetries of the board are only searched once. 
+ * 		With -s the transposition table is also keyed by a symmetry invariant hash, so that mirrored 
+ * 		transpositions share entries.
+ * 		
+ * 		With -t the transposition table is saved to a file after each search, by a saver thread every 
+ * 		TABLE_SAVE_SECS during long searches and when interrupted by SIGINT or SIGTERM, and loaded from it at 
+ * 		startup, so long analyses can be resumed. A loaded table is mapped from its file, so loading is quick 
+ * 		and the search soon reaches its previous depth again. Workers forked by -d local or -l share the 
+ * 		table of the coordinator or server, which saves it for all of them.
+ * 		
+ * 		Built with make profile, each search reports hardware counter events in its main phases (move 
+ * 		generation, evaluation, terminal test, allocation and hash probes) on stderr, see profile.c.
  * Author:	Campbell Lockley		studentID: 1178618
  * Date:	31/03/15
  * ****************************************************************************************************************** */
@@ -14,10 +53,21 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/select.h>
 
 #include "othelloAI.h"
 #include "filo.h"
 #include "minmaxsearch.h"
+#include "distrib.h"
+#include "symmetry.h"
+#include "profile.h"
+#include "solvedb.h"
+#include "ttable.h"
+#include "gamehost.h"
+#include "mcts.h"
 
 /* ******* *
  * Defines *
@@ -26,12 +76,54 @@
 #define PUBLIC
 #define ICONV(x, y)	((y) * BOARD_DIM + (x))				/* Convert (x,y) to 1d array index	      */
 #define FLIP(c)		(((c) == WHITE) ? BLACK : WHITE)
+#define MIN(x,y)	((x) < (y) ? (x) : (y))
+#define MAX(x,y)	((x) > (y) ? (x) : (y))
+#define WIN_BONUS	100						/* Added to winner's discs at game end	      */
+#define FINAL(d)	(((d) > 0) ? (d) + WIN_BONUS : ((d) < 0) ? (d) - WIN_BONUS : 0)	/* utility() at game end */
+#define STABLE_EMPTIES	20						/* Empties at which stability cutoffs start   */
+#define LINES		4						/* Rows, columns, diagonals, anti-diagonals   */
+#define COL_A		0x0101010101010101ULL				/* Squares of column a			      */
+#define COL_H		(COL_A << (BOARD_DIM - 1))
+#define ROW_1		0xffULL						/* Squares of row 1			      */
+#define ROW_8		(ROW_1 << (BOARD_SIZE - BOARD_DIM))
+#define EDGES		(COL_A | COL_H | ROW_1 | ROW_8)
+#define BYTES(b)	(0x0101010101010101ULL * (unsigned char)(b))	/* b in every byte of a word		      */
+#define GATHER		0x0102040810204080ULL				/* Moves bit 8k to bit 56 + k		      */
+/* Bound of a search to depth, given a bound d on the final disc difference */
+#define LIMIT(f,d,depth,empty)	(((depth) >= 2 * (empty)) ? FINAL(d) : f((d) * (1 + stable_weight), FINAL(d)))
+#define STABLE_MAX	255						/* Largest stable disc weight -S allows	      */
+#define TABLE_MB	64						/* Default transposition table size	      */
+#define TABLE_SAVE_SECS	60						/* Time between saves of the table	      */
+#define HASH_VERSION	1						/* Changes whenever hash() keys change	      */
+#define TABLE_TAG	((stable_weight << 8) | (HASH_VERSION << 1) | canonical_hash)	/* Tags hash and utility() */
+#define USAGE		"Usage: %s [-v] [-b database] [-H megabytes] [-s] [-t file] [-S weight] [-e engine] " \
+			"[-m seconds] [-j threads] " \
+			"[-w | -l port | -d worker [-d worker ...] [-r] | -g threads [-c budget]]\n"
+
+/* ******** *
+ * Typedefs *
+ * ******** */
+typedef struct Job {						/* Coordinator's record of a distributed job	      */
+	int board;						/* Index of board this job is for		      */
+	Action *action;						/* Root move searched by a split job, else NULL	      */
+	int sign;						/* -1 if job's estimate is from opponent's side	      */
+} Job;
 
 /* ********** *
  * Prototypes *
  * ********** */
 /* Runs othelloAI to compute best next move									      */
-PUBLIC Action *compute_move  (State *state, int time);
+PUBLIC Action *compute_move       (State *state, int time);
+PUBLIC Action *compute_game_move  (State *state, int time, Context *context);
+PUBLIC void    context_clear      (Context *context);
+PUBLIC Search *compute_move_start (State *state, int time, 
+				   void (*progress)(Action *a, int depth, int nodes, void *data), void *data);
+PUBLIC void    compute_move_stop  (Search *search);
+PUBLIC Action *compute_move_wait  (Search *search, int *depth, int *nodes);
+PUBLIC void    compute_move_set_engine (int engine_used, int below, int threads);
+PUBLIC int     compute_move_depth (void);
+PUBLIC int     compute_move_nodes (void);
+PUBLIC void    stable_discs       (State *state, int *white, int *black);
 
 /* These are othello specific implementatons of the problem domain functions required by minmaxsearch		      */
 PRIVATE Filo  *actions       (State *state);
@@ -42,61 +134,385 @@ PRIVATE Filo  *successors    (State *state);
 PRIVATE void   set_estimate  (Action *a, int estimate);
 PRIVATE void   free_action   (Action *a);
 PRIVATE void   free_state    (State *a);
+PRIVATE bool   bounds        (State *state, int depth, int alpha, int beta, int *lower, int *upper);
+
+/* These are othello specific implementations of the extra problem domain functions required by mcts		      */
+PRIVATE State *playout_step  (State *state, unsigned int *seed);
+PRIVATE int    outcome       (State *state, State *root);
+PRIVATE bool   equal         (State *a, State *b);
+PRIVATE bool   equivalent    (State *a, State *b);
 
 /* Utility functions for othelloAI										      */
 PRIVATE State *move          (State *state, int x, int y);
 PRIVATE State *capture       (State *state, State *successor, int x, int y, int dx, int dy);
+PRIVATE bool   can_move      (State *state);
+PRIVATE uint64_t move_squares (uint64_t own, uint64_t enemy);
+PRIVATE void   stability     (uint64_t white, uint64_t black, int *stable_white, int *stable_black);
+PRIVATE void   lines_init    (void);
+PRIVATE uint64_t squares     (State *state, char c);
 PRIVATE bool   scan_state    (State *state, int *time);
 PRIVATE void   print_state   (State *state);
 PRIVATE State *state_copy    (State *state);
-PRIVATE void   free_actions  (Filo *actions_list);
+PRIVATE void   search_init   (State *state, int time);
+PRIVATE void  *search_thread (void *arg);
+PRIVATE void   search_progress (Action *a, int depth);
+PRIVATE void   print_progress  (Action *a, int depth, int nodes, void *data);
+PRIVATE bool   solved_probe  (State *state, Filo *actions_list, Action **best, int *value);
+PRIVATE void   solved_store  (State *state, Action *best, int value);
+PRIVATE uint64_t hash        (State *state);
+PRIVATE void   hash_init     (void);
+PRIVATE void   table_save    (bool force);
+PRIVATE void   saver_init    (void);
+PRIVATE void  *saver_thread  (void *arg);
+PRIVATE void   saver_signal  (int sig);
+
+/* Game host functions for othelloAI										      */
+PRIVATE int    host_games    (int threads, int budget);
+PRIVATE void   host_moved    (Game *game);
+
+/* Distributed analysis functions for othelloAI								      */
+PRIVATE int    coordinate    (char **specs, int n_specs, bool split);
+PRIVATE char  *handle_job    (const char *job);
+PRIVATE void   encode_state  (State *state, int time, char *job);
+PRIVATE bool   decode_state  (const char *job, State *state, int *time);
+PRIVATE bool   valid_state   (State *state);
+PRIVATE Filo  *unique_roots  (Filo *actions_list);
 
 /* ******* *
  * Globals *
  * ******* */
-PRIVATE char ai_colour;
-PRIVATE int  expand_count = 0;
+PRIVATE __thread char    ai_colour;					/* Player searched for on this thread	      */
+PRIVATE __thread int     expand_count = 0;
+PRIVATE __thread Search *current_search = NULL;				/* Background search being run		      */
+PRIVATE __thread bool    used_mcts = false;				/* Last search on this thread was MCTS	      */
+PRIVATE int              engine = ENGINE_AUTO;				/* Engine used by compute_move()	      */
+PRIVATE int              mcts_below = MCTS_BELOW;			/* ENGINE_AUTO uses MCTS below this time      */
+PRIVATE int              mcts_threads = 1;				/* Threads used by an MCTS search	      */
+PRIVATE TTable          *table = NULL;					/* Shared by all searches		      */
+PRIVATE char            *table_path = NULL;				/* File table is saved to, or NULL	      */
+PRIVATE time_t           table_saved = 0;				/* Time table was last saved or loaded	      */
+PRIVATE pthread_mutex_t  table_mutex = PTHREAD_MUTEX_INITIALIZER;	/* Held while saving table		      */
+PRIVATE pthread_once_t   saver_once = PTHREAD_ONCE_INIT;
+PRIVATE int              saver_pipe[2] = {-1, -1};			/* Signals caught, for the saver thread	      */
+PRIVATE uint64_t         zobrist[BOARD_SIZE][2];			/* Hash keys for each disc		      */
+PRIVATE uint64_t         zobrist_white;					/* Hash key for white to move		      */
+PRIVATE uint64_t         zobrist_ai_white;				/* Hash key for searching for white	      */
+PRIVATE bool             canonical_hash = false;			/* Hash the same for symmetric states	      */
+PRIVATE int              stable_weight = 0;				/* Extra value of a stable disc in utility()  */
+PRIVATE int              sym_index[SYMMETRIES][BOARD_SIZE];		/* sym_square() of each index		      */
+PRIVATE pthread_once_t   zobrist_once = PTHREAD_ONCE_INIT;
+PRIVATE uint64_t         line_mask[LINES][BOARD_SIZE];			/* Squares of each line through a square      */
+PRIVATE const int        line_shift[LINES] = {1, BOARD_DIM, BOARD_DIM + 1, BOARD_DIM - 1};	/* Step along a line  */
+PRIVATE const uint64_t   line_after[LINES] = {~COL_A, ~0ULL, ~COL_A, ~COL_H};	/* Squares with a previous one	      */
+PRIVATE const uint64_t   line_before[LINES] = {~COL_H, ~0ULL, ~COL_H, ~COL_A};	/* Squares with a next one	      */
+PRIVATE pthread_once_t   lines_once = PTHREAD_ONCE_INIT;
 PRIVATE char axis_convert[] = {'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h'};
+PRIVATE const int playout_weight[BOARD_SIZE] = {				/* Chance of a playout move	      */
+	16, 1, 4, 4, 4, 4, 1, 16,
+	 1, 1, 4, 4, 4, 4, 1,  1,
+	 4, 4, 4, 4, 4, 4, 4,  4,
+	 4, 4, 4, 4, 4, 4, 4,  4,
+	 4, 4, 4, 4, 4, 4, 4,  4,
+	 4, 4, 4, 4, 4, 4, 4,  4,
+	 1, 1, 4, 4, 4, 4, 1,  1,
+	16, 1, 4, 4, 4, 4, 1, 16
+};
 
 /* ********* *
  * Functions *
  * ********* */
 /*
  * Reads a board state from stdin and computes a next move, printing move and details to stdout.
+ * Usage: othelloAI [-v] [-b database] [-H megabytes] [-s] [-t file] [-S weight] [-e engine] [-m seconds] [-j threads] 
+ * 		  [-w | -l port | -d worker [-d worker ...] [-r] | -g threads [-c budget]]
+ * 	-v	Print the best move found at each completed depth while searching
+ * 	-b	Look up and record solved positions in a database file, creating it if needed
+ * 	-H	Size of the transposition table in megabytes, 0 for none (default 64)
+ * 	-s	Hash symmetric positions the same, so they share transposition table entries
+ * 	-t	Load the transposition table from a file if it exists (ignoring -H) and save it there
+ * 	-S	Weight of each stable disc in the evaluation of unfinished positions near the end (default 0, off)
+ * 	-e	Search engine: minmax, mcts or auto (default auto)
+ * 	-m	auto uses mcts for time limits below this many seconds, 0 for never (default 10)
+ * 	-j	Threads used by each mcts search (default 1)
+ * 	-w	Run as a worker, reading jobs from stdin and writing results to stdout
+ * 	-l	Run as a worker server, accepting coordinators on a TCP port
+ * 	-d	Coordinate workers, reading boards from stdin until EOF. worker is "local" or "host:port"
+ * 	-r	Split each board's root moves into separate jobs when coordinating. Each job gets the board's time
+ * 		divided by the number of jobs per worker, so the board still takes about its time limit
+ * 	-g	Host many games on a pool of threads, reading "<id> <board> <colour> <clock>" lines from stdin and 
+ * 		printing "<id> move ..." for each as its move is found
+ * 	-c	CPU seconds to divide among all games waiting for or searching a move when hosting 
+ * 		(default 5 per thread, each search getting at most one thread's share)
  */
 int main(int argc, char *argv[]) {
 	State initial_state;						/* Initial state read from stdin	      */
 	int time;							/* Time limit for algorithm		      */
+	int opt, depth, nodes, n_specs = 0, table_mb = TABLE_MB, threads = 0, budget = 0, status;
+	int engine_used = ENGINE_AUTO, below = MCTS_BELOW, engine_threads = 1;
+	bool verbose = false, worker = false, split = false;
+	char *port = NULL, **specs = NULL, *database = NULL;
+	Search *search;
 	Action *a = NULL;
 	
+	/* Parse options */
+	while ((opt = getopt(argc, argv, "vb:H:st:S:e:m:j:wl:d:rg:c:")) != -1) {
+		switch (opt) {
+		case 'v':
+			verbose = true;
+			break;
+		case 'b':
+			database = optarg;
+			break;
+		case 'H':
+			table_mb = atoi(optarg);
+			break;
+		case 's':
+			canonical_hash = true;
+			break;
+		case 'S':
+			stable_weight = atoi(optarg);
+			if (stable_weight < 0 || stable_weight > STABLE_MAX) {
+				fprintf(stderr, "Error: stable disc weight must be 0 to %d\n", STABLE_MAX);
+				return 1;
+			}
+			break;
+		case 't':
+			table_path = optarg;
+			break;
+		case 'e':
+			if (strcmp(optarg, "minmax") == 0) engine_used = ENGINE_MINMAX;
+			else if (strcmp(optarg, "mcts") == 0) engine_used = ENGINE_MCTS;
+			else if (strcmp(optarg, "auto") == 0) engine_used = ENGINE_AUTO;
+			else {
+				fprintf(stderr, USAGE, argv[0]);
+				return 1;
+			}
+			break;
+		case 'm':
+			below = atoi(optarg);
+			break;
+		case 'j':
+			engine_threads = atoi(optarg);
+			break;
+		case 'w':
+			worker = true;
+			break;
+		case 'l':
+			port = optarg;
+			break;
+		case 'd':
+			specs = (char **)realloc(specs, (n_specs + 1) * sizeof(char *));
+			specs[n_specs++] = optarg;
+			break;
+		case 'r':
+			split = true;
+			break;
+		case 'g':
+			threads = atoi(optarg);
+			break;
+		case 'c':
+			budget = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, USAGE, argv[0]);
+			return 1;
+		}
+	}
+	
+	compute_move_set_engine(engine_used, below, engine_threads);
+	
+	/* Open solved position database */
+	if (database != NULL && !solvedb_open(database)) {
+		fprintf(stderr, "Error: could not open database %s\n", database);
+		return 1;
+	}
+	
+	/* Load saved transposition table, or create an empty one */
+	if (table_path != NULL && access(table_path, F_OK) == 0) {
+		if ((table = tt_load(table_path, TABLE_TAG)) == NULL) {
+			fprintf(stderr, "Error: %s is not a transposition table saved with these options\n", table_path);
+			return 1;
+		}
+	} else if (table_mb > 0 && (table = tt_create(table_mb)) == NULL) {
+		fprintf(stderr, "Error: could not create %d MB transposition table\n", table_mb);
+		return 1;
+	}
+	
+	/* Workers forked by -d local or -l all search this one table, which only this process saves */
+	if (table != NULL && (n_specs > 0 || port != NULL)) {
+		if (!tt_share(table)) {
+			fprintf(stderr, "Error: could not share transposition table with workers\n");
+			return 1;
+		}
+		if (table_path) pthread_once(&saver_once, saver_init);	/* Before forking, so workers don't save  */
+	}
+	
+	/* Game host and distributed analysis modes */
+	if (threads > 0 || worker) {
+		if (threads > 0) status = host_games(threads, (budget > 0) ? budget : threads * 5);
+		else status = distrib_worker(STDIN_FILENO, STDOUT_FILENO, handle_job);
+		table_save(true);
+		return status;
+	}
+	if (port != NULL) {
+		distrib_serve(port, handle_job);
+		fprintf(stderr, "Error: could not serve on port %s\n", port);
+		return 1;
+	}
+	if (n_specs > 0) {
+		status = coordinate(specs, n_specs, split);
+		table_save(true);
+		return status;
+	}
+	
 	/* Get initial state from stdin */
 	if(!scan_state(&initial_state, &time)) return 1;
 	
 	/* Compute next move */
-	a = compute_move(&initial_state, time);
+	search = compute_move_start(&initial_state, time * 1000, (verbose) ? print_progress : NULL, NULL);
+	if (search == NULL) return 1;
+	a = compute_move_wait(search, &depth, &nodes);
 	if (a != NULL) {
 		printf("move %c %d nodes %d depth %d minmax %d\n", 
-		       axis_convert[a->x], (a->y) + 1, expand_count, minmax_get_depth(), a->estimate);
+		       axis_convert[a->x], (a->y) + 1, nodes, depth, a->estimate);
 		free_action(a);
 	} else printf("move a -1 nodes 0 depth 0 minmax 0\n");
+	fflush(stdout);							/* Move is not held up by saving	      */
+	table_save(true);
 	
 	return 0;
 }
 
 /*
- * Runs othelloAI to compute best next move.
+ * Runs othelloAI to compute best next move within time milliseconds, using MCTS instead of minmax if selected by 
+ * compute_move_set_engine().
  */
 PUBLIC Action *compute_move(State *state, int time) {
-	ai_colour = state->colour;
-	minmaxsearch_init(time, (Filo *(*)(void *))actions, 		/* Must first init minmaxsearch		      */
-	                  (void *(*)(void *, void *))result, 
-	                  (int(*)(void *))utility, 
-	                  (bool(*)(void *))terminal_test, 
-	                  (Filo *(*)(void *))successors,
-	                  (void(*)(void *, int))set_estimate,
-	                  (void(*)(void *))free_action,
-	                  (void(*)(void *))free_state);
-	return minmax_decision(state);
+	return compute_game_move(state, time, NULL);
+}
+
+/*
+ * Runs compute_move() for one of many games, keeping the game's engine state in context, if not NULL, rather than in 
+ * this thread, so that the game's next move may be searched on any thread.
+ */
+PUBLIC Action *compute_game_move(State *state, int time, Context *context) {
+	Action *best;
+	
+	used_mcts = (engine == ENGINE_MCTS || (engine == ENGINE_AUTO && time < mcts_below * 1000));
+	
+	PROFILE_START();						/* Only with make profile		      */
+	if (used_mcts) {
+		mcts_init(time, mcts_threads, (Filo *(*)(void *))actions, 	/* Must first init mcts		      */
+		          (void *(*)(void *, void *))result, 
+		          (bool(*)(void *))terminal_test, 
+		          (Filo *(*)(void *))successors,
+		          (void *(*)(void *, unsigned int *))playout_step,
+		          (int(*)(void *, void *))outcome,
+		          (bool(*)(void *, void *))equal,
+		          (void *(*)(void *))state_copy,
+		          (void(*)(void *, int))set_estimate,
+		          (void(*)(void *))free_action,
+		          (void(*)(void *))free_state);
+		if (current_search) mcts_set_stop(&(current_search->stop));
+		if (context) mcts_set_tree(&(context->tree));
+		best = mcts_decision(state);
+	} else {
+		search_init(state, time);
+		best = minmax_decision(state);
+	}
+	PROFILE_STOP(compute_move_nodes());
+	
+	return best;
+}
+
+/*
+ * Frees the engine state kept in a game's context, leaving it empty.
+ */
+PUBLIC void context_clear(Context *context) {
+	mcts_free_tree(context->tree);
+	context->tree = NULL;
+}
+
+/*
+ * Selects the engine used by compute_move(). ENGINE_AUTO uses MCTS for time limits below mcts_below seconds and 
+ * minmax for the rest. MCTS searches on mcts_threads threads.
+ */
+PUBLIC void compute_move_set_engine(int engine_used, int below, int threads) {
+	engine = engine_used;
+	mcts_below = below;
+	mcts_threads = (threads > 0) ? threads : 1;
+}
+
+/*
+ * Returns the depth reached by the last compute_move() run on this thread.
+ */
+PUBLIC int compute_move_depth(void) {
+	return (used_mcts) ? mcts_get_depth() : minmax_get_depth();
+}
+
+/*
+ * Returns the number of nodes expanded (or playouts run, for MCTS) by the last compute_move() run on this thread.
+ */
+PUBLIC int compute_move_nodes(void) {
+	return (used_mcts) ? mcts_get_playouts() : expand_count;
+}
+
+/*
+ * Counts each player's stable discs, which can never be flipped for the rest of the game.
+ */
+PUBLIC void stable_discs(State *state, int *white, int *black) {
+	stability(squares(state, WHITE), squares(state, BLACK), white, black);
+}
+
+/*
+ * Starts compute_move() on a background thread. progress(), if not NULL, is called from the search thread with the 
+ * best action found, depth and node count each time a depth is completed; the action is only valid during the call.
+ * Returns NULL if the thread could not be started.
+ */
+PUBLIC Search *compute_move_start(State *state, int time, 
+				  void (*progress)(Action *a, int depth, int nodes, void *data), void *data) {
+	Search *search;
+	
+	search = (Search *)calloc(1, sizeof(Search));
+	search->state = *state;
+	search->time = time;
+	search->progress = progress;
+	search->data = data;
+	atomic_init(&(search->stop), false);
+	
+	if (pthread_create(&(search->thread), NULL, search_thread, search) != 0) {
+		free(search);
+		return NULL;
+	}
+	
+	return search;
+}
+
+/*
+ * Asks a background search to finish early. The search ends within one node and keeps the best action found by its 
+ * last completed depth. May be called from any thread.
+ */
+PUBLIC void compute_move_stop(Search *search) {
+	if (search != NULL) atomic_store(&(search->stop), true);
+}
+
+/*
+ * Waits for a background search to finish, returning its best action and freeing the search. depth and nodes, if not 
+ * NULL, are set to the depth reached and the number of nodes expanded. Returns NULL if the search was stopped before 
+ * a depth was completed.
+ */
+PUBLIC Action *compute_move_wait(Search *search, int *depth, int *nodes) {
+	Action *best;
+	
+	if (search == NULL) return NULL;
+	pthread_join(search->thread, NULL);
+	
+	best = search->best;
+	if (depth) *depth = search->depth;
+	if (nodes) *nodes = search->nodes;
+	free(search);
+	
+	return best;
 }
 
 /*
@@ -110,12 +526,16 @@ PRIVATE Filo *actions(State *state) {
 	
 	filo_init(&action_list);
 	
+	PROFILE_ENTER(PROF_MOVEGEN);
+	
 	/* Check every board position for a possible move */
 	for (y = 0; y < BOARD_DIM; y++) {
 		for (x = 0; x < BOARD_DIM; x++) {
 			result = move(state, x, y);			/* Pre-calculate the result of an action      */
 			if (result != NULL) {
+				PROFILE_ENTER(PROF_ALLOC);
 				a = (Action *)calloc(1, sizeof(Action));
+				PROFILE_LEAVE();
 				a->x = x;
 				a->y = y;
 				a->state = result;
@@ -124,6 +544,7 @@ PRIVATE Filo *actions(State *state) {
 		}
 	}
 	
+	PROFILE_LEAVE();
 	return action_list;
 }
 
@@ -135,12 +556,15 @@ PRIVATE State *result(Action *a, State *state) {
 }
 
 /*
- * Returns utility value for a state.
+ * Returns utility value for a state. With -S, each stable disc of an unfinished state with at most STABLE_EMPTIES 
+ * empties is worth stable_weight more, as the discs it keeps are sure to count at the end. Finding them is slow, so 
+ * this is off by default.
  */
 PRIVATE int utility(State *state) {
-	int i, white = 0, black = 0;
+	int i, white = 0, black = 0, stable_white, stable_black;
 	char c;
 	
+	PROFILE_ENTER(PROF_EVAL);
 	for (i = 0; i < BOARD_SIZE; i++) {
 		c = state->board[i];
 		if (c == WHITE) white++;
@@ -148,10 +572,15 @@ PRIVATE int utility(State *state) {
 	}
 	
 	if (terminal_test(state)) {
-		if (white > black) white += 100;
-		else if (black > white) black += 100;
+		if (white > black) white += WIN_BONUS;
+		else if (black > white) black += WIN_BONUS;
+	} else if (stable_weight > 0 && BOARD_SIZE - white - black <= STABLE_EMPTIES) {
+		stable_discs(state, &stable_white, &stable_black);
+		white += stable_weight * stable_white;
+		black += stable_weight * stable_black;
 	}
 	
+	PROFILE_LEAVE();
 	return (ai_colour == WHITE) ? (white - black) : (black - white);
 }
 
@@ -160,33 +589,161 @@ PRIVATE int utility(State *state) {
  */
 PRIVATE bool terminal_test(State *state) {
 	State *opponent;
-	Filo *actions_list;
-	
-	/* Check if we have possible moves */
-	actions_list = actions(state);
-	if (!filo_isEmpty(&actions_list)) {
-		free_actions(actions_list);
-		return false;
-	}
+	bool terminal = false;
 	
-	free_actions(actions_list);
-	opponent = state_copy(state);
-	if (state->colour == WHITE) opponent->colour = BLACK;
-	else opponent->colour = WHITE;
+	PROFILE_ENTER(PROF_TERMINAL);
 	
-	/* Check if opponent has possible moves */
-	actions_list = actions(opponent);
-	if (!filo_isEmpty(&actions_list)) {
-		free_actions(actions_list);
+	/* Check if we, then opponent have possible moves */
+	if (!can_move(state)) {
+		opponent = state_copy(state);
+		opponent->colour = FLIP(state->colour);
+		terminal = !can_move(opponent);
 		free_state(opponent);
-		return false;
 	}
 	
-	free_actions(actions_list);
-	free_state(opponent);
+	PROFILE_LEAVE();
+	return terminal;
+}
+
+/*
+ * Bounds the value of a search of a state to the given depth using its stable discs (a stability cutoff). Stable 
+ * discs stay on the board, so if we have s stable discs the disc difference of any later state is at least 
+ * 2s - 64, and the opponent's stable discs bound it from above in the same way. A depth of twice the empties always 
+ * reaches the end, as every move fills a square and there are no two passes in a row, so only then are the bounds 
+ * those of a finished game. Before then, utility() may add up to stable_weight for each stable disc, which as stable 
+ * discs stay stable scales the bounds by at most 1 + stable_weight.
+ * Finding stable discs is slow, so returns false without finding them if the state has too many empties for them to 
+ * be likely, or if even every disc being stable would give bounds inside (alpha, beta).
+ */
+PRIVATE bool bounds(State *state, int depth, int alpha, int beta, int *lower, int *upper) {
+	uint64_t white = squares(state, WHITE), black = squares(state, BLACK);
+	int empty, discs, stable_white, stable_black, own, enemy, low, high;
+	
+	empty = BOARD_SIZE - __builtin_popcountll(white | black);
+	if (empty > STABLE_EMPTIES) return false;
+	discs = __builtin_popcountll((ai_colour == WHITE) ? white : black);
+	
+	/* Bounds if all of each player's discs were stable */
+	low = 2 * discs - BOARD_SIZE;
+	high = BOARD_SIZE - 2 * (BOARD_SIZE - empty - discs);
+	if (LIMIT(MAX, high, depth, empty) > alpha && LIMIT(MIN, low, depth, empty) < beta) return false;
+	
+	PROFILE_ENTER(PROF_EVAL);
+	stability(white, black, &stable_white, &stable_black);
+	PROFILE_LEAVE();
+	own = (ai_colour == WHITE) ? stable_white : stable_black;
+	enemy = (ai_colour == WHITE) ? stable_black : stable_white;
+	*lower = LIMIT(MIN, 2 * own - BOARD_SIZE, depth, empty);
+	*upper = LIMIT(MAX, BOARD_SIZE - 2 * enemy, depth, empty);
+	
 	return true;
 }
 
+/*
+ * Counts each player's stable discs, which can never be flipped, given the squares of each player's discs. A disc 
+ * is stable if, along each of the 4 lines through it, the line is full or the disc is next to the edge or to a 
+ * stable disc of its own colour. Discs on corners are always stable, and stability spreads out from them along the 
+ * edges and into the board, so this is repeated until no more stable discs are found. Each line is tested for every 
+ * disc at once using bitboards, as this is run at many nodes of an endgame search.
+ */
+PRIVATE void stability(uint64_t white, uint64_t black, int *stable_white, int *stable_black) {
+	static const uint64_t wall[LINES] = {COL_A | COL_H, ROW_1 | ROW_8, EDGES, EDGES};	/* Next to edge	      */
+	uint64_t discs[2] = {white, black}, empty = ~(white | black), full[LINES], stable, last, safe;
+	int i, k, c;
+	
+	pthread_once(&lines_once, lines_init);
+	
+	/* Find full lines, by removing every line through an empty square */
+	for (k = 0; k < LINES; k++) full[k] = ~0ULL;
+	for (; empty != 0; empty &= empty - 1) {
+		i = __builtin_ctzll(empty);
+		for (k = 0; k < LINES; k++) full[k] &= ~line_mask[k][i];
+	}
+	
+	for (c = 0; c < 2; c++) {
+		stable = 0;
+		do {
+			last = stable;
+			safe = discs[c];
+			for (k = 0; k < LINES; k++) {
+				safe &= full[k] | wall[k] | ((last << line_shift[k]) & line_after[k])
+					| ((last >> line_shift[k]) & line_before[k]);
+			}
+			stable = safe;
+		} while (stable != last);
+		if (c == 0) *stable_white = __builtin_popcountll(stable);
+		else *stable_black = __builtin_popcountll(stable);
+	}
+}
+
+/*
+ * Returns the squares of a state holding the character c, testing a row of squares at a time. Assumes a little-endian 
+ * machine, so that square x of a row is byte x of its word.
+ */
+PRIVATE uint64_t squares(State *state, char c) {
+	uint64_t word, match, mask = 0;
+	int y;
+	
+	for (y = 0; y < BOARD_DIM; y++) {
+		memcpy(&word, &(state->board[ICONV(0, y)]), sizeof(word));
+		word ^= BYTES(c);					/* Matching squares are now 0 bytes	      */
+		match = ~(((word & BYTES(0x7f)) + BYTES(0x7f)) | word) & BYTES(0x80);	/* Top bit of each 0 byte     */
+		mask |= (((match >> 7) * GATHER) >> 56) << ICONV(0, y);
+	}
+	
+	return mask;
+}
+
+/*
+ * Fills line_mask with the squares on each line through each square.
+ */
+PRIVATE void lines_init(void) {
+	static const int dx[LINES] = {1, 0, 1, -1}, dy[LINES] = {0, 1, 1, 1};
+	int x, y, k, step, lx, ly;
+	
+	for (y = 0; y < BOARD_DIM; y++) {
+		for (x = 0; x < BOARD_DIM; x++) {
+			for (k = 0; k < LINES; k++) {
+				for (step = -BOARD_DIM; step <= BOARD_DIM; step++) {
+					lx = x + step * dx[k];
+					ly = y + step * dy[k];
+					if (lx < 0 || lx >= BOARD_DIM || ly < 0 || ly >= BOARD_DIM) continue;
+					line_mask[k][ICONV(x, y)] |= 1ULL << ICONV(lx, ly);
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Checks if the player to move in a state has any possible moves.
+ */
+PRIVATE bool can_move(State *state) {
+	return move_squares(squares(state, state->colour), squares(state, FLIP(state->colour))) != 0;
+}
+
+/*
+ * Returns the empty squares where a player with discs on own can move against discs on enemy. A square is a move if, 
+ * along some direction, it is followed by a run of enemy discs and then one of own. The runs are grown from own discs 
+ * in all 8 directions at once using bitboards, so no boards are made.
+ */
+PRIVATE uint64_t move_squares(uint64_t own, uint64_t enemy) {
+	uint64_t empty = ~(own | enemy), up, down, moves = 0;
+	int i, k;
+	
+	for (k = 0; k < LINES; k++) {
+		up = (own << line_shift[k]) & line_after[k] & enemy;
+		down = (own >> line_shift[k]) & line_before[k] & enemy;
+		for (i = 0; i < BOARD_DIM - 3; i++) {		/* A run is at most BOARD_DIM - 2 discs long	      */
+			up |= (up << line_shift[k]) & line_after[k] & enemy;
+			down |= (down >> line_shift[k]) & line_before[k] & enemy;
+		}
+		moves |= ((up << line_shift[k]) & line_after[k]) | ((down >> line_shift[k]) & line_before[k]);
+	}
+	
+	return moves & empty;
+}
+
 /*
  * Expands a state.
  */
@@ -197,6 +754,7 @@ PRIVATE Filo *successors(State *state) {
 	
 	expand_count++;
 	filo_init(&successor_list);
+	PROFILE_ENTER(PROF_MOVEGEN);
 	
 	/* Check every board position for a possible move which will result in a new state */
 	for (y = 0; y < BOARD_DIM; y++) {
@@ -213,6 +771,7 @@ PRIVATE Filo *successors(State *state) {
 		filo_push(&successor_list, successor);
 	}
 	
+	PROFILE_LEAVE();
 	return successor_list;
 }
 
@@ -227,15 +786,83 @@ PRIVATE void set_estimate(Action *a, int estimate) {
  * Safely frees an action.
  */
 PRIVATE void free_action(Action *a) {
+	PROFILE_ENTER(PROF_ALLOC);
 	free(a->state);
 	free(a);
+	PROFILE_LEAVE();
 }
 
 /*
  * Safely frees a state.
  */
 PRIVATE void free_state(State *state) {
+	PROFILE_ENTER(PROF_ALLOC);
 	free(state);
+	PROFILE_LEAVE();
+}
+
+/*
+ * Returns a random child of a state for a playout, favouring corners and avoiding the squares next to them. Returns 
+ * NULL if the game is over. The possible moves are found with move_squares(), so only the chosen one is made.
+ */
+PRIVATE State *playout_step(State *state, unsigned int *seed) {
+	uint64_t own = squares(state, state->colour), enemy = squares(state, FLIP(state->colour)), moves, left;
+	State *pass;
+	int i, pick, total = 0;
+	
+	/* If no move possible, pass unless opponent can't move either */
+	moves = move_squares(own, enemy);
+	if (moves == 0) {
+		if (move_squares(enemy, own) == 0) return NULL;
+		pass = state_copy(state);
+		pass->colour = FLIP(pass->colour);
+		return pass;
+	}
+	
+	/* Choose each possible move with probability weight / total */
+	for (left = moves; left != 0; left &= left - 1) total += playout_weight[__builtin_ctzll(left)];
+	pick = rand_r(seed) % total;
+	for (left = moves; ; left &= left - 1) {
+		i = __builtin_ctzll(left);
+		pick -= playout_weight[i];
+		if (pick < 0) break;
+	}
+	
+	return move(state, i % BOARD_DIM, i / BOARD_DIM);
+}
+
+/*
+ * Returns > 0 if the player to move in root has won a finished game, < 0 if they have lost and 0 for a draw. The size 
+ * is their disc difference, so MCTS estimates are on the same scale as minmax ones.
+ */
+PRIVATE int outcome(State *state, State *root) {
+	int i, own = 0, enemy = 0;
+	
+	for (i = 0; i < BOARD_SIZE; i++) {
+		if (state->board[i] == root->colour) own++;
+		else if (state->board[i] != EMPTY) enemy++;
+	}
+	
+	return own - enemy;
+}
+
+/*
+ * Checks if two states are the same.
+ */
+PRIVATE bool equal(State *a, State *b) {
+	return a->colour == b->colour && memcmp(a->board, b->board, BOARD_SIZE) == 0;
+}
+
+/*
+ * Checks if two states are the same under some symmetry of the board, so have the same value.
+ */
+PRIVATE bool equivalent(State *a, State *b) {
+	State canon_a, canon_b;
+	
+	sym_canonical(a, &canon_a);
+	sym_canonical(b, &canon_b);
+	
+	return equal(&canon_a, &canon_b);
 }
 
 /*
@@ -350,7 +977,7 @@ PRIVATE bool scan_state(State *state, int *time) {
 		7 ........
 		8 ........
 		B 60			*/
-
+	
 	if (scanf("- abcdefgh\n") == EOF) success = false;
 	for (i = 0, index = 0; i < BOARD_DIM; i++) {
 		if (scanf("%d ", &ign) == EOF) success = false;
@@ -389,7 +1016,9 @@ PRIVATE State *state_copy(State *state) {
 	int i;
 	State *copy;
 	
+	PROFILE_ENTER(PROF_ALLOC);
 	copy = (State *)calloc(1, sizeof(State));
+	PROFILE_LEAVE();
 	for (i = 0; i < BOARD_SIZE; i++) copy->board[i] = state->board[i];
 	copy->colour = state->colour;
 	
@@ -397,13 +1026,506 @@ PRIVATE State *state_copy(State *state) {
 }
 
 /*
- * Safely frees a Filo<Action>.
+ * Prepares minmaxsearch to search from a state.
+ */
+PRIVATE void search_init(State *state, int time) {
+	ai_colour = state->colour;
+	expand_count = 0;
+	minmaxsearch_init(time, (Filo *(*)(void *))actions, 		/* Must first init minmaxsearch		      */
+	                  (void *(*)(void *, void *))result, 
+	                  (int(*)(void *))utility, 
+	                  (bool(*)(void *))terminal_test, 
+	                  (Filo *(*)(void *))successors,
+	                  (void(*)(void *, int))set_estimate,
+	                  (void(*)(void *))free_action,
+	                  (void(*)(void *))free_state);
+	if (solvedb_isopen()) {
+		minmaxsearch_set_solved((bool(*)(void *, Filo *, void **, int *))solved_probe, 
+		                        (void(*)(void *, void *, int))solved_store);
+	}
+	if (table != NULL) {
+		pthread_once(&zobrist_once, hash_init);
+		minmaxsearch_set_table(table, (uint64_t(*)(void *))hash);
+		if (table_path) pthread_once(&saver_once, saver_init);	/* Save table during searches	      */
+	}
+	minmaxsearch_set_bounds((bool(*)(void *, int, int, int, int *, int *))bounds);
+	minmaxsearch_set_equivalent((bool(*)(void *, void *))equivalent);
+	if (current_search) minmaxsearch_set_progress((void(*)(void *, int))search_progress);
+	if (current_search) minmaxsearch_set_stop(&(current_search->stop));	/* Running for compute_move_start()   */
+}
+
+/*
+ * Runs the search started by compute_move_start().
+ */
+PRIVATE void *search_thread(void *arg) {
+	Search *search = (Search *)arg;
+	
+	current_search = search;
+	search->best = compute_move(&(search->state), search->time);
+	search->depth = compute_move_depth();
+	search->nodes = compute_move_nodes();
+	current_search = NULL;
+	
+	return NULL;
+}
+
+/*
+ * Passes a completed depth of the current background search on to its progress callback.
+ */
+PRIVATE void search_progress(Action *a, int depth) {
+	if (current_search && current_search->progress) {
+		current_search->progress(a, depth, expand_count, current_search->data);
+	}
+}
+
+/*
+ * Prints the best move found at a completed depth to stdout.
  */
-PRIVATE void free_actions(Filo *actions_list) {
+PRIVATE void print_progress(Action *a, int depth, int nodes, void *data) {
+	if (a == NULL) return;
+	printf("info move %c %d nodes %d depth %d minmax %d\n", axis_convert[a->x], (a->y) + 1, nodes, depth, a->estimate);
+	fflush(stdout);
+}
+
+/*
+ * Reads boards from stdin until EOF and has them solved by workers, printing a move for each board in order. If split 
+ * is true, each root move of a board is sent as its own job and the coordinator takes the best of them.
+ */
+PRIVATE int coordinate(char **specs, int n_specs, bool split) {
+	State *boards = NULL, *child;
+	Action **best, *a;
+	Filo *actions_list;
+	Job *info = NULL;
+	char **jobs = NULL, **results;
+	int *times = NULL, *limits = NULL, *v, *depth, *nodes, n_boards = 0, n_jobs = 0, i, b, c, x, y, est, dep, cnt, first, time;
+	bool success = true, *invalid;
+	
+	/* Read every board */
+	while ((c = getchar()) != EOF) {
+		ungetc(c, stdin);
+		boards = (State *)realloc(boards, (n_boards + 1) * sizeof(State));
+		times = (int *)realloc(times, (n_boards + 1) * sizeof(int));
+		if (!scan_state(&boards[n_boards], &times[n_boards])) return 1;
+		n_boards++;
+	}
+	
+	/* Bad boards get no jobs, as every worker would fail them */
+	invalid = (bool *)calloc(n_boards, sizeof(bool));
+	for (b = 0; b < n_boards; b++) {
+		if (valid_state(&boards[b])) continue;
+		fprintf(stderr, "Error: board %d is not valid\n", b + 1);
+		invalid[b] = true;
+		success = false;
+	}
+	
+	best = (Action **)calloc(n_boards, sizeof(Action *));
+	v = (int *)calloc(n_boards, sizeof(int));
+	depth = (int *)calloc(n_boards, sizeof(int));
+	nodes = (int *)calloc(n_boards, sizeof(int));
+	
+	/* Create jobs */
+	for (b = 0; b < n_boards; b++) {
+		v[b] = INT_MIN;
+		depth[b] = INT_MAX;
+		if (invalid[b]) continue;
+		
+		if (!split) {
+			jobs = (char **)realloc(jobs, (n_jobs + 1) * sizeof(char *));
+			limits = (int *)realloc(limits, (n_jobs + 1) * sizeof(int));
+			info = (Job *)realloc(info, (n_jobs + 1) * sizeof(Job));
+			info[n_jobs].board = b;
+			info[n_jobs].action = NULL;
+			info[n_jobs].sign = +1;
+			limits[n_jobs] = times[b];
+			jobs[n_jobs] = (char *)malloc(DISTRIB_LINE);
+			encode_state(&boards[b], times[b], jobs[n_jobs++]);
+			continue;
+		}
+		
+		/* Split jobs search the child of a root move, so their estimate is from the opponent's side */
+		first = n_jobs;
+		actions_list = unique_roots(actions(&boards[b]));
+		while (!filo_isEmpty(&actions_list)) {
+			a = filo_pop(&actions_list);
+			child = a->state;
+			
+			/* Game over, so score child here */
+			if (terminal_test(child)) {
+				ai_colour = boards[b].colour;
+				est = utility(child);
+				if (est > v[b]) {
+					v[b] = est;
+					best[b] = a;
+				}
+				depth[b] = MIN(depth[b], 1);
+				continue;
+			}
+			
+			jobs = (char **)realloc(jobs, (n_jobs + 1) * sizeof(char *));
+			limits = (int *)realloc(limits, (n_jobs + 1) * sizeof(int));
+			info = (Job *)realloc(info, (n_jobs + 1) * sizeof(Job));
+			info[n_jobs].board = b;
+			info[n_jobs].action = a;
+			info[n_jobs].sign = -1;
+			
+			/* Opponent must pass, so search child from our side */
+			if (!can_move(child)) {
+				child->colour = FLIP(child->colour);
+				info[n_jobs].sign = +1;
+			}
+			
+			n_jobs++;
+		}
+		
+		/* Share the board's time between its jobs, which run up to n_specs at a time */
+		if (n_jobs == first) continue;
+		time = MIN(times[b], MAX(1, times[b] * n_specs / (n_jobs - first)));
+		for (i = first; i < n_jobs; i++) {
+			limits[i] = time;
+			jobs[i] = (char *)malloc(DISTRIB_LINE);
+			encode_state(info[i].action->state, time, jobs[i]);
+		}
+	}
+	
+	/* Run jobs */
+	results = (char **)calloc(n_jobs, sizeof(char *));
+	if (!distrib_run(specs, n_specs, jobs, limits, results, n_jobs, handle_job)) success = false;
+	
+	/* Combine results of each board */
+	for (i = 0; i < n_jobs; i++) {
+		b = info[i].board;
+		if (results[i] == NULL) {
+			fprintf(stderr, "Error: job %d failed\n", i);
+			continue;
+		}
+		if (sscanf(results[i], "%d %d %d %d %d", &x, &y, &est, &dep, &cnt) != 5) continue;
+		est *= info[i].sign;
+		nodes[b] += cnt;
+		
+		if (info[i].action == NULL) {				/* Whole board was one job		      */
+			if (x < 0) continue;
+			a = (Action *)calloc(1, sizeof(Action));
+			a->x = x;
+			a->y = y;
+			best[b] = a;
+			v[b] = est;
+			depth[b] = dep;
+		} else {						/* Job was one root move		      */
+			depth[b] = MIN(depth[b], dep + 1);
+			if (est > v[b]) {
+				v[b] = est;
+				best[b] = info[i].action;
+			}
+		}
+	}
+	
+	/* Print moves in input order */
+	for (b = 0; b < n_boards; b++) {
+		if (best[b] != NULL) {
+			printf("move %c %d nodes %d depth %d minmax %d\n", 
+			       axis_convert[best[b]->x], (best[b]->y) + 1, nodes[b], depth[b], v[b]);
+		} else printf("move a -1 nodes 0 depth 0 minmax 0\n");
+	}
+	
+	return (success) ? 0 : 1;
+}
+
+/*
+ * Solves a job sent by a coordinator, returning "x y estimate depth nodes" for the best move found.
+ */
+PRIVATE char *handle_job(const char *job) {
+	State state;
 	Action *a;
+	char *result;
+	int time;
 	
+	if (!decode_state(job, &state, &time)) return NULL;
+	
+	result = (char *)malloc(DISTRIB_LINE);
+	a = compute_move(&state, time * 1000);
+	if (a != NULL) {
+		snprintf(result, DISTRIB_LINE, "%d %d %d %d %d", a->x, a->y, a->estimate, compute_move_depth(), 
+		         compute_move_nodes());
+		free_action(a);
+	} else snprintf(result, DISTRIB_LINE, "-1 -1 0 0 %d", compute_move_nodes());
+	
+	return result;
+}
+
+/*
+ * Writes a state and time limit as a job line of the form "<board> <colour> <time>".
+ */
+PRIVATE void encode_state(State *state, int time, char *job) {
+	snprintf(job, DISTRIB_LINE, "%.*s %c %d", BOARD_SIZE, state->board, state->colour, time);
+}
+
+/*
+ * Reads a state and time limit from a job line. Returns false if the job is malformed.
+ */
+PRIVATE bool decode_state(const char *job, State *state, int *time) {
+	char board[BOARD_SIZE + 1];
+	
+	if (sscanf(job, "%64s %c %d", board, &(state->colour), time) != 3) return false;
+	if (strlen(board) != BOARD_SIZE) return false;
+	memcpy(state->board, board, BOARD_SIZE);
+	
+	return valid_state(state);
+}
+
+/*
+ * Frees each action whose result is equivalent to that of an earlier action, as unique_actions() does for a search, so 
+ * only one of them is sent as a job. Returns the remaining actions in the same order.
+ */
+PRIVATE Filo *unique_roots(Filo *actions_list) {
+	Filo *kept, *unique, *node;
+	Action *a;
+	bool seen;
+	
+	filo_init(&kept);
 	while (!filo_isEmpty(&actions_list)) {
 		a = filo_pop(&actions_list);
-		free_action(a);
+		seen = false;
+		for (node = kept; !seen && !filo_isEmpty(&node); node = node->next) {
+			seen = equivalent(((Action *)node->value)->state, a->state);
+		}
+		if (seen) free_action(a);
+		else filo_push(&kept, a);
+	}
+	
+	/* kept is in reverse order */
+	filo_init(&unique);
+	while (!filo_isEmpty(&kept)) filo_push(&unique, filo_pop(&kept));
+	
+	return unique;
+}
+
+/*
+ * Returns true if a state's board holds only empty, white and black squares and its colour is white or black.
+ */
+PRIVATE bool valid_state(State *state) {
+	int i;
+	
+	if (state->colour != WHITE && state->colour != BLACK) return false;
+	for (i = 0; i < BOARD_SIZE; i++) {
+		if (state->board[i] != EMPTY && state->board[i] != WHITE && state->board[i] != BLACK) return false;
+	}
+	
+	return true;
+}
+
+/*
+ * Looks up a state in the solved position database. The best move is stored for the canonical form of the state, so 
+ * is matched to the action which moves to the same square under the state's canonical transform.
+ */
+PRIVATE bool solved_probe(State *state, Filo *actions_list, Action **best, int *value) {
+	State canon;
+	Action *a;
+	int t, move, score;
+	
+	t = sym_canonical(state, &canon);
+	if (!solvedb_lookup(&canon, &move, &score)) return false;
+	
+	for (; !filo_isEmpty(&actions_list); actions_list = actions_list->next) {
+		a = actions_list->value;
+		if (sym_square(t, a->x, a->y) == move) {
+			*best = a;
+			*value = score;
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+/*
+ * Records a solved state in the solved position database. The value is from the side of the player to move, which 
+ * is also the side utility() scores for at the root of a search.
+ */
+PRIVATE void solved_store(State *state, Action *best, int value) {
+	State canon;
+	int t;
+	
+	t = sym_canonical(state, &canon);
+	solvedb_store(&canon, sym_square(t, best->x, best->y), value);
+}
+
+/*
+ * Hashes a state for the transposition table. utility() scores for ai_colour, so it is part of the hash too. With 
+ * canonical_hash the board is hashed under every symmetry and the smallest key used, which utility() allows as it 
+ * is the same for symmetric states.
+ */
+PRIVATE uint64_t hash(State *state) {
+	uint64_t key = 0, keys[SYMMETRIES] = {0};
+	int i, t, c;
+	
+	if (!canonical_hash) {
+		for (i = 0; i < BOARD_SIZE; i++) {
+			if (state->board[i] == BLACK) key ^= zobrist[i][0];
+			else if (state->board[i] == WHITE) key ^= zobrist[i][1];
+		}
+	} else {
+		for (i = 0; i < BOARD_SIZE; i++) {
+			if (state->board[i] == EMPTY) continue;
+			c = (state->board[i] == WHITE);
+			for (t = 0; t < SYMMETRIES; t++) keys[t] ^= zobrist[sym_index[t][i]][c];
+		}
+		key = keys[0];
+		for (t = 1; t < SYMMETRIES; t++) key = MIN(key, keys[t]);
+	}
+	if (state->colour == WHITE) key ^= zobrist_white;
+	if (ai_colour == WHITE) key ^= zobrist_ai_white;
+	
+	return key;
+}
+
+/*
+ * Fills the hash keys with pseudo-random numbers (splitmix64). The seed is fixed so keys are the same in every run.
+ */
+PRIVATE void hash_init(void) {
+	uint64_t seed = 0x0123456789abcdefULL, *keys[BOARD_SIZE * 2 + 2], z;
+	int i, t;
+	
+	for (t = 0; t < SYMMETRIES; t++) {
+		for (i = 0; i < BOARD_SIZE; i++) sym_index[t][i] = sym_square(t, i % BOARD_DIM, i / BOARD_DIM);
+	}
+	
+	for (i = 0; i < BOARD_SIZE * 2; i++) keys[i] = &zobrist[i / 2][i % 2];
+	keys[i++] = &zobrist_white;
+	keys[i++] = &zobrist_ai_white;
+	
+	for (i = 0; i < BOARD_SIZE * 2 + 2; i++) {
+		z = (seed += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		*keys[i] = z ^ (z >> 31);
 	}
 }
+
+/*
+ * Saves the transposition table to table_path, if given. Unless forced, the table is only saved if TABLE_SAVE_SECS 
+ * have passed since it was last saved and no other thread is saving it.
+ */
+PRIVATE void table_save(bool force) {
+	time_t now;
+	
+	if (table == NULL || table_path == NULL) return;
+	if (force) pthread_mutex_lock(&table_mutex);
+	else if (pthread_mutex_trylock(&table_mutex) != 0) return;
+	
+	time(&now);
+	if (table_saved == 0) table_saved = now;			/* First search since loading		      */
+	if (force || difftime(now, table_saved) >= TABLE_SAVE_SECS) {
+		if (!tt_save(table, table_path, TABLE_TAG)) {
+			fprintf(stderr, "Error: could not save transposition table to %s\n", table_path);
+		}
+		time(&table_saved);
+	}
+	
+	pthread_mutex_unlock(&table_mutex);
+}
+
+/*
+ * Starts the saver thread, which saves the table every TABLE_SAVE_SECS and when SIGINT or SIGTERM is caught. Run once 
+ * per process, by the first search using the table, or by a coordinator or server before it forks workers.
+ */
+PRIVATE void saver_init(void) {
+	struct sigaction act;
+	pthread_t thread;
+	
+	pthread_mutex_lock(&table_mutex);
+	if (table_saved == 0) time(&table_saved);			/* First save is TABLE_SAVE_SECS from now     */
+	pthread_mutex_unlock(&table_mutex);
+	
+	if (pipe(saver_pipe) != 0) return;
+	if (pthread_create(&thread, NULL, saver_thread, NULL) != 0) return;
+	pthread_detach(thread);
+	
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = saver_signal;
+	sigemptyset(&act.sa_mask);
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+}
+
+/*
+ * Saves the table whenever TABLE_SAVE_SECS pass without a save, while searches go on using it. When a signal is 
+ * caught, saves the table then lets the signal end the process.
+ */
+PRIVATE void *saver_thread(void *arg) {
+	struct timeval timeout;
+	fd_set fds;
+	unsigned char sig;
+	
+	for (;;) {
+		FD_ZERO(&fds);
+		FD_SET(saver_pipe[0], &fds);
+		timeout.tv_sec = TABLE_SAVE_SECS;
+		timeout.tv_usec = 0;
+		if (select(saver_pipe[0] + 1, &fds, NULL, NULL, &timeout) <= 0) {
+			table_save(false);
+			continue;
+		}
+		
+		if (read(saver_pipe[0], &sig, 1) != 1) continue;
+		table_save(true);
+		signal(sig, SIG_DFL);
+		kill(getpid(), sig);
+	}
+	
+	return NULL;
+}
+
+/*
+ * Passes a caught signal on to the saver thread, as saving isn't safe in a signal handler.
+ */
+PRIVATE void saver_signal(int sig) {
+	unsigned char c = (unsigned char)sig;
+	
+	if (write(saver_pipe[1], &c, 1) != 1) signal(sig, SIG_DFL);
+}
+
+/*
+ * Reads games from stdin until EOF and plays them on a pool of threads, printing each game's move as it is found.
+ */
+PRIVATE int host_games(int threads, int budget) {
+	char line[DISTRIB_LINE];
+	Game *game;
+	int n;
+	
+	if (!gamehost_start(threads, budget, host_moved)) {
+		fprintf(stderr, "Error: could not start %d threads\n", threads);
+		return 1;
+	}
+	
+	/* Lines are "<id> <board> <colour> <clock>", the same as a distributed job after the id */
+	while (fgets(line, sizeof(line), stdin) != NULL) {
+		game = (Game *)calloc(1, sizeof(Game));
+		if (sscanf(line, "%63s %n", game->id, &n) != 1 
+		    || !decode_state(line + n, &(game->state), &(game->clock))) {
+			fprintf(stderr, "Error: bad game %s", line);
+			free(game);
+			continue;
+		}
+		gamehost_submit(game);
+	}
+	
+	gamehost_stop();
+	
+	return 0;
+}
+
+/*
+ * Prints a hosted game's move and frees the game. Called from the thread which searched it.
+ */
+PRIVATE void host_moved(Game *game) {
+	Action *a = game->move;
+	
+	if (a != NULL) {
+		printf("%s move %c %d nodes %d depth %d minmax %d time %.3f\n", game->id, axis_convert[a->x], (a->y) + 1, 
+		       game->nodes, game->depth, a->estimate, game->time / 1000.0);
+		free_action(a);
+	} else printf("%s move a -1 nodes 0 depth 0 minmax 0 time %.3f\n", game->id, game->time / 1000.0);
+	fflush(stdout);
+	
+	free(game);
+}
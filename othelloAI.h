@@ -8,6 +8,12 @@
 #ifndef _OTHELLOAI_H
 #define _OTHELLOAI_H
 
+/* ******** *
+ * Includes *
+ * ******** */
+#include <pthread.h>
+#include <stdatomic.h>
+
 /* ******* *
  * Defines *
  * ******* */
@@ -16,6 +22,10 @@
 #define EMPTY		'.'
 #define BLACK		'B'
 #define WHITE		'O'
+#define ENGINE_AUTO	0						/* Engine chosen by time limit		      */
+#define ENGINE_MINMAX	1
+#define ENGINE_MCTS	2
+#define MCTS_BELOW	10						/* Seconds below which ENGINE_AUTO uses MCTS  */
 
 /* ******** *
  * Typedefs *
@@ -32,9 +42,35 @@ typedef struct Action {						/* othelloAI's definition of an action		      */
 	int estimate;
 } Action;
 
+typedef struct Context {					/* Engine state kept between moves of one game	      */
+	struct MctsTree *tree;					/* MCTS tree kept from the last move, or NULL	      */
+} Context;
+
+typedef struct Search {						/* A search running on a background thread	      */
+	pthread_t thread;
+	State state;						/* Copy of the initial state being searched	      */
+	int time;						/* Milliseconds					      */
+	void (*progress)(Action *a, int depth, int nodes, void *data);
+	void *data;						/* Passed through to progress()			      */
+	atomic_bool stop;					/* Set by compute_move_stop()			      */
+	Action *best;
+	int depth;
+	int nodes;
+} Search;
+
 /* ********** *
  * Prototypes *
  * ********** */
-extern Action *compute_move(State *state, int time);		/* Runs othelloAI to comute best next move	      */
+extern Action *compute_move       (State *state, int time);	/* Runs othelloAI to comute best next move	      */
+extern Action *compute_game_move  (State *state, int time, Context *context);	/* compute_move() for one game */
+extern void    context_clear      (Context *context);		/* Frees the engine state kept for a game	      */
+extern Search *compute_move_start (State *state, int time,	/* Starts compute_move() on a background thread	      */
+				   void (*progress)(Action *a, int depth, int nodes, void *data), void *data);
+extern void    compute_move_stop  (Search *search);		/* Asks a background search to finish early	      */
+extern Action *compute_move_wait  (Search *search, int *depth, int *nodes);	/* Collects result of a search */
+extern void    compute_move_set_engine (int engine, int mcts_below, int mcts_threads);	/* Selects search engine */
+extern int     compute_move_depth (void);			/* Depth reached by this thread's last search	      */
+extern int     compute_move_nodes (void);			/* Nodes expanded by this thread's last search	      */
+extern void    stable_discs       (State *state, int *white, int *black);	/* Counts discs never flipped */
 
 #endif
@@ -0,0 +1,243 @@
+/* ****************************************************************************************************************** *
+ * Name:	profile.c
+ * Description:	Counts hardware events (cycles, instructions, cache misses and branch misses) in each phase of a
+ * 		search using Linux perf_event_open() counters, and reports them per search and per node on stderr.
+ *
+ * 		profile_start() opens a group of counters for the calling thread and profile_stop() reports and closes
+ * 		them. In between, profile_enter() and profile_leave() mark the phases, which may nest. Events are
+ * 		counted in the innermost phase only, so allocation done while generating moves counts as allocation,
+ * 		and anything outside the marked phases counts as search. Phases on other threads (eg. MCTS helper
+ * 		threads) are not counted.
+ *
+ * 		Each phase change reads the counters with a system call, so a profiled search runs much slower and
+ * 		the counts include some of this overhead. Counters which can't be opened (eg. no PMU in a virtual
+ * 		machine, or perf_event_paranoid too high) are reported as "-", leaving at least calls and time.
+ *
+ * 		The file is empty unless built with -DPROFILE (make profile), as perf_event_open() needs Linux kernel
+ * 		headers which the normal build shouldn't.
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+#ifdef PROFILE
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "profile.h"
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define PRIVATE		static
+#define PUBLIC
+#define COUNTERS	4						/* Hardware counters in a group		      */
+#define VALUES		(COUNTERS + 1)					/* Counters then elapsed time		      */
+#define TIME		COUNTERS					/* Index of elapsed time in values	      */
+#define STACK_MAX	32						/* Deepest nesting of phases recorded	      */
+
+/* ********** *
+ * Prototypes *
+ * ********** */
+PUBLIC void profile_start (void);
+PUBLIC void profile_stop  (int nodes);
+PUBLIC void profile_enter (int phase);
+PUBLIC void profile_leave (void);
+
+PRIVATE void open_counters  (void);
+PRIVATE void close_counters (void);
+PRIVATE void sample         (void);
+PRIVATE void print_row      (const char *name, uint64_t calls, uint64_t *values, double per);
+
+/* ******* *
+ * Globals *
+ * ******* */
+PRIVATE const uint64_t counter_config[COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                   PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+PRIVATE const char    *phase_name[PROF_PHASES] = {"search", "movegen", "eval", "terminal", "alloc", "hash"};
+PRIVATE __thread bool     active = false;				/* Counting a search on this thread	      */
+PRIVATE __thread int      leader = -1;					/* Group leader's fd, or -1 if none open      */
+PRIVATE __thread int      fds[COUNTERS];				/* Each counter's fd, or -1		      */
+PRIVATE __thread int      slot[COUNTERS];				/* Each counter's place in a group read	      */
+PRIVATE __thread int      open_errno;					/* Why the first counter failed to open	      */
+PRIVATE __thread uint64_t last[VALUES];					/* Values when last sampled		      */
+PRIVATE __thread uint64_t total[PROF_PHASES][VALUES];			/* Values counted in each phase		      */
+PRIVATE __thread uint64_t calls[PROF_PHASES];				/* Times each phase was entered		      */
+PRIVATE __thread int      stack[STACK_MAX];				/* Phases entered and not yet left	      */
+PRIVATE __thread int      depth;					/* Phases on stack (may be > STACK_MAX)	      */
+
+/* ********* *
+ * Functions *
+ * ********* */
+/*
+ * Starts counting a search on this thread, opening the counters.
+ */
+PUBLIC void profile_start(void) {
+	if (active) close_counters();
+	
+	stack[0] = PROF_SEARCH;
+	depth = 1;
+	open_counters();
+	active = true;
+	sample();							/* Set starting values			      */
+	
+	memset(total, 0, sizeof(total));
+	memset(calls, 0, sizeof(calls));
+	calls[PROF_SEARCH] = 1;
+}
+
+/*
+ * Stops counting a search on this thread and reports each phase's events, in total and per node, on stderr.
+ */
+PUBLIC void profile_stop(int nodes) {
+	uint64_t sum[VALUES] = {0}, sum_calls = 0;
+	int p, i;
+	
+	if (!active) return;
+	sample();
+	active = false;
+	
+	for (p = 0; p < PROF_PHASES; p++) {
+		for (i = 0; i < VALUES; i++) sum[i] += total[p][i];
+		sum_calls += calls[p];
+	}
+	
+	flockfile(stderr);						/* Keep reports of threads apart	      */
+	fprintf(stderr, "profile: %d nodes", nodes);
+	if (leader < 0) fprintf(stderr, ", hardware counters unavailable (%s)", strerror(open_errno));
+	fprintf(stderr, "\nprofile: %-9s %12s %14s %14s %14s %14s %14s\n", "phase", "calls", "ns", "cycles",
+	        "instructions", "cache misses", "branch misses");
+	for (p = 0; p < PROF_PHASES; p++) print_row(phase_name[p], calls[p], total[p], 1);
+	print_row("total", sum_calls, sum, 1);
+	if (nodes > 0) {
+		fprintf(stderr, "profile: per node\n");
+		for (p = 0; p < PROF_PHASES; p++) print_row(phase_name[p], calls[p], total[p], nodes);
+		print_row("total", sum_calls, sum, nodes);
+	}
+	funlockfile(stderr);
+	
+	close_counters();
+}
+
+/*
+ * Counts events from now on in phase, until profile_leave().
+ */
+PUBLIC void profile_enter(int phase) {
+	if (!active) return;
+	sample();							/* Events so far were in enclosing phase      */
+	if (depth < STACK_MAX) stack[depth] = phase;
+	depth++;
+	calls[phase]++;
+}
+
+/*
+ * Counts events from now on in the phase enclosing the one last entered.
+ */
+PUBLIC void profile_leave(void) {
+	if (!active || depth <= 1) return;
+	sample();
+	depth--;
+}
+
+/*
+ * Opens as many of the counters as possible as one group counting this thread in user space. The first counter
+ * opened leads the group.
+ */
+PRIVATE void open_counters(void) {
+	struct perf_event_attr attr;
+	int i, n = 0;
+	
+	leader = -1;
+	open_errno = 0;
+	for (i = 0; i < COUNTERS; i++) {
+		memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = counter_config[i];
+		attr.disabled = (leader < 0);				/* Group starts when all are open	      */
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP;
+	
+		fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+		slot[i] = -1;
+		if (fds[i] < 0) {
+			if (open_errno == 0) open_errno = errno;
+			continue;
+		}
+		if (leader < 0) leader = fds[i];
+		slot[i] = n++;
+	}
+	
+	if (leader >= 0) {
+		ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+}
+
+/*
+ * Closes any open counters.
+ */
+PRIVATE void close_counters(void) {
+	int i;
+	
+	for (i = 0; i < COUNTERS; i++) {
+		if (fds[i] >= 0) close(fds[i]);
+		fds[i] = -1;
+	}
+	leader = -1;
+}
+
+/*
+ * Reads the counters and clock, adding the events since the last sample to the current phase.
+ */
+PRIVATE void sample(void) {
+	struct {
+		uint64_t nr;
+		uint64_t values[COUNTERS];
+	} group;
+	struct timespec now;
+	uint64_t values[VALUES] = {0};
+	int i, phase = stack[((depth < STACK_MAX) ? depth : STACK_MAX) - 1];
+	
+	if (leader >= 0 && read(leader, &group, sizeof(group)) > 0) {
+		for (i = 0; i < COUNTERS; i++) {
+			if (slot[i] >= 0 && (uint64_t)slot[i] < group.nr) values[i] = group.values[slot[i]];
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	values[TIME] = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+	
+	for (i = 0; i < VALUES; i++) {
+		total[phase][i] += values[i] - last[i];
+		last[i] = values[i];
+	}
+}
+
+/*
+ * Prints a phase's calls, time and events divided by per. Counters which aren't open are printed as "-".
+ */
+PRIVATE void print_row(const char *name, uint64_t calls, uint64_t *values, double per) {
+	int i;
+	
+	fprintf(stderr, "profile: %-9s %12.1f %14.1f", name, calls / per, values[TIME] / per);
+	for (i = 0; i < COUNTERS; i++) {
+		if (slot[i] >= 0) fprintf(stderr, " %14.1f", values[i] / per);
+		else fprintf(stderr, " %14s", "-");
+	}
+	fprintf(stderr, "\n");
+}
+
+#endif
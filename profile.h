@@ -0,0 +1,43 @@
+/* ****************************************************************************************************************** *
+ * Name:	profile.h
+ * Description:	Header file for profile.c. The PROFILE_ macros compile to nothing unless built with -DPROFILE (make
+ * 		profile), so they may be left in the search's hot paths.
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define PROF_SEARCH	0						/* Time in no other phase		      */
+#define PROF_MOVEGEN	1						/* Move generation			      */
+#define PROF_EVAL	2						/* Evaluation				      */
+#define PROF_TERMINAL	3						/* Terminal test			      */
+#define PROF_ALLOC	4						/* Allocating and freeing		      */
+#define PROF_HASH	5						/* Hashing and table probes		      */
+#define PROF_PHASES	6
+
+#ifdef PROFILE
+#define PROFILE_START()		profile_start()
+#define PROFILE_STOP(nodes)	profile_stop(nodes)
+#define PROFILE_ENTER(phase)	profile_enter(phase)
+#define PROFILE_LEAVE()		profile_leave()
+#else
+#define PROFILE_START()		((void)0)
+#define PROFILE_STOP(nodes)	((void)0)
+#define PROFILE_ENTER(phase)	((void)0)
+#define PROFILE_LEAVE()		((void)0)
+#endif
+
+/* ********** *
+ * Prototypes *
+ * ********** */
+extern void profile_start (void);				/* Starts counting a search on this thread	      */
+extern void profile_stop  (int nodes);				/* Stops counting and reports on stderr		      */
+extern void profile_enter (int phase);				/* Counts following events in phase		      */
+extern void profile_leave (void);				/* Returns to counting the enclosing phase	      */
+
+#endif
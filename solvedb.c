@@ -0,0 +1,277 @@
+/* ****************************************************************************************************************** *
+ * Name:	solvedb.c
+ * Description:	An on-disk database of positions which have been solved exactly, shared between runs and between
+ * 		engine processes. Positions are stored in canonical form (see symmetry.c) so that symmetric positions
+ * 		share a record.
+ *
+ * 		The file is a SolvedHeader followed by fixed size SolvedRecords, which are only ever appended. Each
+ * 		process maps the file read-only and keeps an in-memory hash index of record numbers, which is brought
+ * 		up to date whenever the file is seen to have grown. Appends are made under an fcntl() write lock so
+ * 		that processes never write the same position twice or interleave records.
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "solvedb.h"
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define PRIVATE		static
+#define PUBLIC
+#define INDEX_MIN	1024						/* Initial number of index slots	      */
+#define FNV_OFFSET	14695981039346656037ULL
+#define FNV_PRIME	1099511628211ULL
+
+/* ********** *
+ * Prototypes *
+ * ********** */
+PUBLIC bool solvedb_open   (const char *path);
+PUBLIC bool solvedb_isopen (void);
+PUBLIC bool solvedb_lookup (State *canon, int *move, int *score);
+PUBLIC void solvedb_store  (State *canon, int move, int score);
+PUBLIC void solvedb_close  (void);
+
+PRIVATE bool          lock_file   (int type);
+PRIVATE void          refresh     (void);
+PRIVATE void          index_add   (uint32_t record);
+PRIVATE SolvedRecord *find        (SolvedRecord *position);
+PRIVATE void          pack        (State *canon, SolvedRecord *position);
+
+/* ******* *
+ * Globals *
+ * ******* */
+PRIVATE int             db_fd = -1;					/* Open database file		      */
+PRIVATE char           *db_map = NULL;					/* Read-only mapping of file	      */
+PRIVATE size_t          db_map_size = 0;
+PRIVATE uint32_t        db_records = 0;					/* Records in index		      */
+PRIVATE uint32_t       *db_index = NULL;				/* Record number + 1, or 0 if free    */
+PRIVATE uint32_t        db_index_size = 0;				/* Slots in index, a power of 2	      */
+PRIVATE pthread_mutex_t db_mutex = PTHREAD_MUTEX_INITIALIZER;		/* Guards all of the above	      */
+
+/* ********* *
+ * Functions *
+ * ********* */
+/*
+ * Opens the database at path, creating it if it doesn't exist. Returns false if the file can't be opened or is not a
+ * database of this version.
+ */
+PUBLIC bool solvedb_open(const char *path) {
+	SolvedHeader header, expected;
+	struct stat st;
+	bool valid = true;
+
+	memset(&expected, 0, sizeof(expected));
+	strncpy(expected.magic, SOLVEDB_MAGIC, sizeof(expected.magic));
+	expected.version = SOLVEDB_VERSION;
+	expected.record_size = sizeof(SolvedRecord);
+
+	pthread_mutex_lock(&db_mutex);
+	if (db_fd >= 0) {						/* Already open				      */
+		pthread_mutex_unlock(&db_mutex);
+		return false;
+	}
+	if ((db_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644)) < 0) {
+		pthread_mutex_unlock(&db_mutex);
+		return false;
+	}
+
+	/* Write header of a new database, or check header of an existing one */
+	lock_file(F_WRLCK);
+	if (fstat(db_fd, &st) != 0) valid = false;
+	else if (st.st_size == 0) valid = (write(db_fd, &expected, sizeof(expected)) == sizeof(expected));
+	else valid = (pread(db_fd, &header, sizeof(header), 0) == sizeof(header)
+		      && memcmp(&header, &expected, sizeof(header)) == 0);
+	lock_file(F_UNLCK);
+
+	if (!valid) {
+		close(db_fd);
+		db_fd = -1;
+	} else refresh();
+
+	pthread_mutex_unlock(&db_mutex);
+	return valid;
+}
+
+/*
+ * Checks if a database is open.
+ */
+PUBLIC bool solvedb_isopen(void) {
+	bool open;
+
+	pthread_mutex_lock(&db_mutex);
+	open = (db_fd >= 0);
+	pthread_mutex_unlock(&db_mutex);
+
+	return open;
+}
+
+/*
+ * Finds a canonical position in the database, setting its best move and score. Returns false if it isn't there.
+ */
+PUBLIC bool solvedb_lookup(State *canon, int *move, int *score) {
+	SolvedRecord position, *record;
+
+	pack(canon, &position);
+
+	pthread_mutex_lock(&db_mutex);
+	if (db_fd < 0) {
+		pthread_mutex_unlock(&db_mutex);
+		return false;
+	}
+	refresh();							/* Pick up other processes' records	      */
+	if ((record = find(&position)) != NULL) {
+		*move = record->move;
+		*score = record->score;
+	}
+	pthread_mutex_unlock(&db_mutex);
+
+	return record != NULL;
+}
+
+/*
+ * Appends a solved canonical position to the database, unless it is already there.
+ */
+PUBLIC void solvedb_store(State *canon, int move, int score) {
+	SolvedRecord position;
+
+	pack(canon, &position);
+	position.move = (int8_t)move;
+	position.score = (int16_t)score;
+
+	pthread_mutex_lock(&db_mutex);
+	if (db_fd < 0 || !lock_file(F_WRLCK)) {
+		pthread_mutex_unlock(&db_mutex);
+		return;
+	}
+
+	refresh();							/* Must see every record before appending     */
+	if (find(&position) == NULL && write(db_fd, &position, sizeof(position)) == sizeof(position)) refresh();
+
+	lock_file(F_UNLCK);
+	pthread_mutex_unlock(&db_mutex);
+}
+
+/*
+ * Closes the database.
+ */
+PUBLIC void solvedb_close(void) {
+	pthread_mutex_lock(&db_mutex);
+	if (db_map != NULL) munmap(db_map, db_map_size);
+	if (db_fd >= 0) close(db_fd);
+	free(db_index);
+	db_fd = -1;
+	db_map = NULL;
+	db_map_size = 0;
+	db_records = 0;
+	db_index = NULL;
+	db_index_size = 0;
+	pthread_mutex_unlock(&db_mutex);
+}
+
+/*
+ * Takes (F_WRLCK) or releases (F_UNLCK) the whole file lock, waiting for other processes.
+ */
+PRIVATE bool lock_file(int type) {
+	struct flock lock;
+
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = type;
+	lock.l_whence = SEEK_SET;					/* l_start = l_len = 0 locks whole file	      */
+
+	return fcntl(db_fd, F_SETLKW, &lock) == 0;
+}
+
+/*
+ * Remaps the file if it has grown and adds any new complete records to the index.
+ */
+PRIVATE void refresh(void) {
+	struct stat st;
+	uint32_t records;
+	void *map;
+
+	if (fstat(db_fd, &st) != 0 || (size_t)st.st_size <= db_map_size) return;
+
+	records = (st.st_size - sizeof(SolvedHeader)) / sizeof(SolvedRecord);
+	if (records == db_records) return;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, db_fd, 0);
+	if (map == MAP_FAILED) return;
+	if (db_map != NULL) munmap(db_map, db_map_size);
+	db_map = (char *)map;
+	db_map_size = st.st_size;
+
+	while (db_records < records) index_add(db_records++);
+}
+
+/*
+ * Adds a record to the index, growing the index to keep it at most half full.
+ */
+PRIVATE void index_add(uint32_t record) {
+	SolvedRecord *records = (SolvedRecord *)(db_map + sizeof(SolvedHeader));
+	uint32_t *old = db_index, old_size = db_index_size, i, slot;
+
+	if ((record + 1) * 2 > db_index_size) {
+		db_index_size = (db_index_size == 0) ? INDEX_MIN : db_index_size * 2;
+		db_index = (uint32_t *)calloc(db_index_size, sizeof(uint32_t));
+		for (i = 0; i < old_size; i++) {
+			if (old[i] == 0) continue;
+			slot = records[old[i] - 1].key & (db_index_size - 1);
+			while (db_index[slot] != 0) slot = (slot + 1) & (db_index_size - 1);
+			db_index[slot] = old[i];
+		}
+		free(old);
+	}
+
+	slot = records[record].key & (db_index_size - 1);
+	while (db_index[slot] != 0) slot = (slot + 1) & (db_index_size - 1);
+	db_index[slot] = record + 1;
+}
+
+/*
+ * Finds the record of a packed position. Returns NULL if it isn't indexed.
+ */
+PRIVATE SolvedRecord *find(SolvedRecord *position) {
+	SolvedRecord *records = (SolvedRecord *)(db_map + sizeof(SolvedHeader)), *record;
+	uint32_t slot;
+
+	if (db_index_size == 0) return NULL;
+
+	for (slot = position->key & (db_index_size - 1); db_index[slot] != 0; slot = (slot + 1) & (db_index_size - 1)) {
+		record = &records[db_index[slot] - 1];
+		if (record->key == position->key && record->black == position->black && record->white == position->white
+		    && record->colour == position->colour) return record;
+	}
+
+	return NULL;
+}
+
+/*
+ * Packs a canonical position into a record, setting its key.
+ */
+PRIVATE void pack(State *canon, SolvedRecord *position) {
+	uint64_t key = FNV_OFFSET;
+	int i;
+
+	memset(position, 0, sizeof(SolvedRecord));
+	for (i = 0; i < BOARD_SIZE; i++) {
+		if (canon->board[i] == BLACK) position->black |= 1ULL << i;
+		else if (canon->board[i] == WHITE) position->white |= 1ULL << i;
+		key = (key ^ (unsigned char)canon->board[i]) * FNV_PRIME;
+	}
+	position->colour = canon->colour;
+	position->key = (key ^ (unsigned char)canon->colour) * FNV_PRIME;
+}
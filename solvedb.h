@@ -0,0 +1,53 @@
+/* ****************************************************************************************************************** *
+ * Name:	solvedb.h
+ * Description:	Header file for solvedb.c
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+#ifndef _SOLVEDB_H
+#define _SOLVEDB_H
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "othelloAI.h"
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define SOLVEDB_MAGIC	"OTHSOLV"					/* Identifies a solved position database      */
+#define SOLVEDB_VERSION	1
+
+/* ******** *
+ * Typedefs *
+ * ******** */
+typedef struct SolvedHeader {					/* Start of a solved position database file	      */
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+} SolvedHeader;
+
+typedef struct SolvedRecord {					/* A solved position, appended to the file	      */
+	uint64_t key;						/* Hash of canonical position			      */
+	uint64_t black;						/* Bit (y * 8 + x) set for each black disc	      */
+	uint64_t white;						/* Bit (y * 8 + x) set for each white disc	      */
+	char colour;						/* Player to move				      */
+	int8_t move;						/* Index of best move in canonical position	      */
+	int16_t score;						/* Exact minmax value for player to move	      */
+	uint32_t reserved;
+} SolvedRecord;
+
+/* ********** *
+ * Prototypes *
+ * ********** */
+extern bool solvedb_open   (const char *path);			/* Opens or creates a database			      */
+extern bool solvedb_isopen (void);				/* Checks if a database is open			      */
+extern bool solvedb_lookup (State *canon, int *move, int *score);	/* Finds a solved canonical position	      */
+extern void solvedb_store  (State *canon, int move, int score);	/* Appends a solved canonical position	      */
+extern void solvedb_close  (void);				/* Closes the database				      */
+
+#endif
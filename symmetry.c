@@ -0,0 +1,75 @@
+/* ****************************************************************************************************************** *
+ * Name:	symmetry.c
+ * Description:	The 8 symmetries of the othello board (rotations and reflections). Each symmetry is a transform t,
+ * 		made of the SYM_ bits: the board is first transposed if SYM_TRANSPOSE is set, then mirrored in x 
+ * 		and/or y. Transform 0 is the identity.
+ * 
+ * 		The canonical form of a state is the image of it, under all 8 transforms, with the smallest board. 
+ * 		Symmetric states have the same canonical form, so it can be used to key anything known about a 
+ * 		position.
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include <string.h>
+
+#include "symmetry.h"
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define ICONV(x, y)	((y) * BOARD_DIM + (x))				/* Convert (x,y) to 1d array index	      */
+
+/* ********* *
+ * Functions *
+ * ********* */
+/*
+ * Returns the index of the square which (x,y) moves to under transform t.
+ */
+int sym_square(int t, int x, int y) {
+	int tmp;
+	
+	if (t & SYM_TRANSPOSE) {
+		tmp = x;
+		x = y;
+		y = tmp;
+	}
+	if (t & SYM_FLIP_X) x = BOARD_DIM - 1 - x;
+	if (t & SYM_FLIP_Y) y = BOARD_DIM - 1 - y;
+	
+	return ICONV(x, y);
+}
+
+/*
+ * Applies transform t to a state, storing the result in image.
+ */
+void sym_transform(int t, State *state, State *image) {
+	int x, y;
+	
+	for (y = 0; y < BOARD_DIM; y++) {
+		for (x = 0; x < BOARD_DIM; x++) image->board[sym_square(t, x, y)] = state->board[ICONV(x, y)];
+	}
+	image->colour = state->colour;
+}
+
+/*
+ * Finds the canonical form of a state, storing it in canon. Returns the transform which maps state to canon.
+ */
+int sym_canonical(State *state, State *canon) {
+	State image;
+	int t, best = 0;
+	
+	*canon = *state;						/* Identity is first candidate		      */
+	for (t = 1; t < SYMMETRIES; t++) {
+		sym_transform(t, state, &image);
+		if (memcmp(image.board, canon->board, BOARD_SIZE) < 0) {
+			*canon = image;
+			best = t;
+		}
+	}
+	
+	return best;
+}
@@ -0,0 +1,31 @@
+/* ****************************************************************************************************************** *
+ * Name:	symmetry.h
+ * Description:	Header file for symmetry.c
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+#ifndef _SYMMETRY_H
+#define _SYMMETRY_H
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include "othelloAI.h"
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define SYMMETRIES	8						/* Number of symmetries of the board	      */
+#define SYM_FLIP_X	1						/* Transform mirrors board left to right      */
+#define SYM_FLIP_Y	2						/* Transform mirrors board top to bottom      */
+#define SYM_TRANSPOSE	4						/* Transform swaps x and y, before flips      */
+
+/* ********** *
+ * Prototypes *
+ * ********** */
+extern int  sym_square    (int t, int x, int y);		/* Index square (x,y) moves to under transform t      */
+extern void sym_transform (int t, State *state, State *image);	/* Applies transform t to a state		      */
+extern int  sym_canonical (State *state, State *canon);	/* Finds canonical form of a state, returning its t   */
+
+#endif
@@ -0,0 +1,204 @@
+/* ****************************************************************************************************************** *
+ * Name:	ttable.c
+ * Description:	A lock-free transposition table which may be shared by any number of searching threads. Each entry 
+ * 		records the value of a searched state, the depth it was searched to (its draft) and whether the 
+ * 		value is exact or a bound.
+ * 
+ * 		An entry is two 64 bit words, the data and the key xor'd with the data. Threads read and write the 
+ * 		words without locking, so an entry may be torn by two threads writing it at once, but a torn entry 
+ * 		no longer matches its key and is simply missed.
+ * 
+ * 		A table may be saved to a file with tt_save(), as a TTHeader followed by its entries, and loaded 
+ * 		again with tt_load(). A loaded table is a private copy-on-write mapping of the file, so loading is 
+ * 		quick however large the table, and changes to it are not written back until it is saved again. The 
+ * 		header's tag must match on loading, so that keys made with a different hash function are not used.
+ * 
+ * 		tt_share() moves a table into shared memory, so that processes forked afterwards all use the same 
+ * 		table rather than copies of it. Entries are only ever read and written with atomic operations, so 
+ * 		this is as safe as sharing the table between threads.
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ttable.h"
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define PACK(v, d, b)	((uint64_t)(uint32_t)(v) | ((uint64_t)(d) << 32) | ((uint64_t)(b) << 40))
+#define VALUE(data)	((int)(int32_t)(uint32_t)(data))
+#define DRAFT(data)	((int)(((data) >> 32) & 0xff))
+#define BOUND(data)	((int)(((data) >> 40) & 0x3))
+#define PATH_MAX_LEN	4096						/* Longest path of a saved table	      */
+
+/* ********* *
+ * Functions *
+ * ********* */
+/*
+ * Creates an empty table using at most the given number of megabytes. Returns NULL on failure.
+ */
+TTable *tt_create(int megabytes) {
+	TTable *table;
+	uint64_t size = 1;
+	
+	if (megabytes <= 0) return NULL;
+	while (size * 2 * sizeof(TTEntry) <= (uint64_t)megabytes << 20) size *= 2;
+	
+	table = (TTable *)calloc(1, sizeof(TTable));
+	table->entries = (TTEntry *)calloc(size, sizeof(TTEntry));
+	if (table->entries == NULL) {
+		free(table);
+		return NULL;
+	}
+	table->size = size;
+	
+	return table;
+}
+
+/*
+ * Finds the entry for a key, setting its value, draft and bound. Returns false if the key has no entry.
+ */
+bool tt_probe(TTable *table, uint64_t key, int *value, int *draft, int *bound) {
+	TTEntry *entry = &(table->entries[key & (table->size - 1)]);
+	uint64_t check, data;
+	
+	check = atomic_load_explicit(&(entry->check), memory_order_relaxed);
+	data = atomic_load_explicit(&(entry->data), memory_order_relaxed);
+	if ((check ^ data) != key || data == 0) return false;		/* Other key, torn or empty		      */
+	
+	*value = VALUE(data);
+	*draft = DRAFT(data);
+	*bound = BOUND(data);
+	
+	return true;
+}
+
+/*
+ * Stores the value of a key searched to draft. An entry for the same key is only replaced by one of at least its 
+ * draft, while an entry for another key is always replaced.
+ */
+void tt_store(TTable *table, uint64_t key, int value, int draft, int bound) {
+	TTEntry *entry = &(table->entries[key & (table->size - 1)]);
+	uint64_t check, data;
+	
+	check = atomic_load_explicit(&(entry->check), memory_order_relaxed);
+	data = atomic_load_explicit(&(entry->data), memory_order_relaxed);
+	if ((check ^ data) == key && DRAFT(data) > draft) return;	/* Keep deeper result			      */
+	
+	data = PACK(value, draft, bound);
+	atomic_store_explicit(&(entry->data), data, memory_order_relaxed);
+	atomic_store_explicit(&(entry->check), key ^ data, memory_order_relaxed);
+}
+
+/*
+ * Saves a table to path, tagged with the hash function used for its keys. The table is written to a temporary file 
+ * which then replaces path, so path always holds a whole table even if saving fails part way. Other threads may 
+ * keep using the table while it is saved. Returns false on failure.
+ */
+bool tt_save(TTable *table, const char *path, uint32_t tag) {
+	char temp[PATH_MAX_LEN];
+	TTHeader header;
+	TTEntry entry;
+	FILE *file;
+	uint64_t i;
+	bool saved;
+	
+	if (snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid()) >= (int)sizeof(temp)) return false;
+	if ((file = fopen(temp, "wb")) == NULL) return false;
+	
+	memset(&header, 0, sizeof(header));
+	strncpy(header.magic, TT_MAGIC, sizeof(header.magic));
+	header.version = TT_VERSION;
+	header.entry_size = sizeof(TTEntry);
+	header.tag = tag;
+	header.size = table->size;
+	saved = (fwrite(&header, sizeof(header), 1, file) == 1);
+	
+	for (i = 0; saved && i < table->size; i++) {
+		atomic_init(&(entry.check), atomic_load_explicit(&(table->entries[i].check), memory_order_relaxed));
+		atomic_init(&(entry.data), atomic_load_explicit(&(table->entries[i].data), memory_order_relaxed));
+		saved = (fwrite(&entry, sizeof(entry), 1, file) == 1);
+	}
+	
+	if (fclose(file) != 0) saved = false;
+	if (saved) saved = (rename(temp, path) == 0);
+	if (!saved) unlink(temp);
+	
+	return saved;
+}
+
+/*
+ * Loads a table saved by tt_save() by mapping its file. Returns NULL if the file can't be mapped, is not a table of 
+ * this version or its tag differs.
+ */
+TTable *tt_load(const char *path, uint32_t tag) {
+	TTable *table;
+	TTHeader header;
+	struct stat st;
+	void *map;
+	int fd;
+	
+	if ((fd = open(path, O_RDONLY)) < 0) return NULL;
+	if (fstat(fd, &st) != 0 || read(fd, &header, sizeof(header)) != sizeof(header)
+	    || strncmp(header.magic, TT_MAGIC, sizeof(header.magic)) != 0 || header.version != TT_VERSION
+	    || header.entry_size != sizeof(TTEntry) || header.tag != tag
+	    || header.size == 0 || (header.size & (header.size - 1)) != 0
+	    || (uint64_t)st.st_size != sizeof(header) + header.size * sizeof(TTEntry)) {
+		close(fd);
+		return NULL;
+	}
+	
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);							/* Mapping stays valid			      */
+	if (map == MAP_FAILED) return NULL;
+	
+	table = (TTable *)calloc(1, sizeof(TTable));
+	table->entries = (TTEntry *)((char *)map + sizeof(header));
+	table->size = header.size;
+	table->map = map;
+	table->map_size = st.st_size;
+	
+	return table;
+}
+
+/*
+ * Moves a table into memory shared with any processes forked after this, so that they all use this one table. Other 
+ * threads must not be using the table. Returns false if shared memory can't be had, leaving the table as it was.
+ */
+bool tt_share(TTable *table) {
+	size_t size = table->size * sizeof(TTEntry);
+	void *map;
+	
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) return false;
+	memcpy(map, table->entries, size);
+	
+	if (table->map != NULL) munmap(table->map, table->map_size);
+	else free(table->entries);
+	table->entries = (TTEntry *)map;
+	table->map = map;
+	table->map_size = size;
+	
+	return true;
+}
+
+/*
+ * Frees a table.
+ */
+void tt_destroy(TTable *table) {
+	if (table == NULL) return;
+	if (table->map != NULL) munmap(table->map, table->map_size);
+	else free(table->entries);
+	free(table);
+}
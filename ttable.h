@@ -0,0 +1,63 @@
+/* ****************************************************************************************************************** *
+ * Name:	ttable.h
+ * Description:	Header file for ttable.c
+ * Author:	Campbell Lockley		studentID: 1178618
+ * Date:	19/10/26
+ * ****************************************************************************************************************** */
+
+#ifndef _TTABLE_H
+#define _TTABLE_H
+
+/* ******** *
+ * Includes *
+ * ******** */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* ******* *
+ * Defines *
+ * ******* */
+#define TT_EXACT	0						/* Value is exact			      */
+#define TT_LOWER	1						/* Value is a lower bound (failed high)	      */
+#define TT_UPPER	2						/* Value is an upper bound (failed low)	      */
+#define TT_SOLVED	255						/* Draft of a value searched to game end      */
+#define TT_MAGIC	"OTHTTAB"					/* Identifies a saved table		      */
+#define TT_VERSION	1						/* Format of a saved table		      */
+
+/* ******** *
+ * Typedefs *
+ * ******** */
+typedef struct TTEntry {					/* An entry, stored as (key ^ data, data)	      */
+	_Atomic uint64_t check;
+	_Atomic uint64_t data;
+} TTEntry;
+
+typedef struct TTable {						/* A transposition table			      */
+	TTEntry *entries;
+	uint64_t size;						/* Number of entries, a power of 2		      */
+	void *map;						/* Mapping of a loaded or shared table, else NULL     */
+	size_t map_size;
+} TTable;
+
+typedef struct TTHeader {					/* Start of a saved table, followed by entries	      */
+	char magic[8];						/* TT_MAGIC					      */
+	uint32_t version;					/* TT_VERSION					      */
+	uint32_t entry_size;					/* sizeof(TTEntry)				      */
+	uint32_t tag;						/* Identifies the hash function used for keys	      */
+	uint32_t reserved;
+	uint64_t size;						/* Number of entries				      */
+} TTHeader;
+
+/* ********** *
+ * Prototypes *
+ * ********** */
+extern TTable *tt_create  (int megabytes);			/* Creates an empty table			      */
+extern bool    tt_probe   (TTable *table, uint64_t key, int *value, int *draft, int *bound);	/* Finds an entry     */
+extern void    tt_store   (TTable *table, uint64_t key, int value, int draft, int bound);	/* Stores an entry    */
+extern bool    tt_save    (TTable *table, const char *path, uint32_t tag);	/* Saves a table to a file	      */
+extern TTable *tt_load    (const char *path, uint32_t tag);	/* Maps a saved table				      */
+extern bool    tt_share   (TTable *table);			/* Shares a table with processes forked later	      */
+extern void    tt_destroy (TTable *table);			/* Frees a table				      */
+
+#endif